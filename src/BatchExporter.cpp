@@ -0,0 +1,195 @@
+#include "BatchExporter.h"
+
+#include "ModelLoader.h"
+#include "ThreadBudget.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace imp {
+static char const* kExportFlag = "--export";
+static char const* kRecolorFlag = "--recolor";
+static char const* kRetextureFlag = "--retexture";
+
+static std::optional<ExportFormat> ParseFormat(std::string format)
+{
+    std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+    if (format == "mqo") {
+        return ExportFormat::MQO;
+    }
+    if (format == "dat") {
+        return ExportFormat::DAT;
+    }
+    if (format == "glb") {
+        return ExportFormat::GLB;
+    }
+    return std::nullopt;
+}
+
+static bool IsModelFile(std::filesystem::path const& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".mqo" || extension == ".dat";
+}
+
+bool BatchExporter::IsBatchCommand(int argc, char** argv)
+{
+    return argc > 1 && std::strcmp(argv[1], kExportFlag) == 0;
+}
+
+int BatchExporter::Run(int argc, char** argv)
+{
+    if (argc < 5) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::optional<ExportFormat> format = ParseFormat(argv[2]);
+    if (!format.has_value()) {
+        IMP_LOG_ERROR("Unknown export format: %s", argv[2]);
+        PrintUsage();
+        return 2;
+    }
+
+    std::filesystem::path outputDirectory = argv[3];
+    std::error_code ec;
+    std::filesystem::create_directories(outputDirectory, ec);
+    if (!std::filesystem::is_directory(outputDirectory)) {
+        IMP_LOG_ERROR("Output directory is not usable: %s", outputDirectory.string().c_str());
+        return 2;
+    }
+
+    std::vector<Input> inputs;
+    RecolorDefinition definition;
+    for (int i = 4; i < argc; ++i) {
+        bool isRecolor = std::strcmp(argv[i], kRecolorFlag) == 0;
+        bool isRetexture = std::strcmp(argv[i], kRetextureFlag) == 0;
+        if (!isRecolor && !isRetexture) {
+            CollectInputs(argv[i], inputs);
+            continue;
+        }
+        if (++i == argc) {
+            IMP_LOG_ERROR("Missing pairs after %s", argv[i - 1]);
+            PrintUsage();
+            return 2;
+        }
+        std::string errorMessage;
+        bool parsed = isRecolor ? RecolorDefinition::ParseColors(argv[i], definition, errorMessage)
+                                : RecolorDefinition::ParseMaterials(argv[i], definition, errorMessage);
+        if (!parsed) {
+            IMP_LOG_ERROR("Invalid %s pairs: %s", argv[i - 1], errorMessage.c_str());
+            return 2;
+        }
+    }
+
+    // Two workers writing the same file at once would leave it corrupt.
+    if (FindDuplicateOutputs(inputs, outputDirectory, *format)) {
+        return 2;
+    }
+
+    // Built once and shared read-only by all the workers.
+    std::optional<ModelRecolor> recolor;
+    if (!definition.IsEmpty()) {
+        recolor.emplace(definition);
+    }
+
+    // Models are independent, so they are converted on as many threads as
+    // the machine has, each taking the next file from a shared counter.
+    std::atomic<size_t> nextFile { 0 };
+    std::atomic<size_t> failed { 0 };
+    auto worker = [&] {
+        for (size_t i = nextFile++; i < inputs.size(); i = nextFile++) {
+            if (!ExportFile(inputs[i], outputDirectory, *format, recolor ? &*recolor : nullptr)) {
+                ++failed;
+            }
+        }
+    };
+
+    // The workers are reserved from the shared budget, so the parsers they
+    // run do not start threads of their own on top.
+    ThreadBudget budget(static_cast<uint32_t>(std::max<size_t>(inputs.size(), 1) - 1));
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < budget.GetCount(); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    IMP_LOG_INFO("Exported %zu of %zu models.", inputs.size() - failed.load(), inputs.size());
+    return failed == 0 ? 0 : 1;
+}
+
+void BatchExporter::PrintUsage()
+{
+    IMP_LOG_ERROR("Usage: modelviewer %s <mqo|dat|glb> <output-directory> [%s <find=replace,...>] [%s <find=replace,...>] <input>...", kExportFlag, kRecolorFlag, kRetextureFlag);
+}
+
+void BatchExporter::CollectInputs(std::filesystem::path const& input, std::vector<Input>& inputs)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec)) {
+        for (auto const& entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+            if (entry.is_regular_file() && IsModelFile(entry.path())) {
+                std::filesystem::path output = entry.path().lexically_relative(input);
+                inputs.push_back({ entry.path(), output.replace_extension() });
+            }
+        }
+    } else if (std::filesystem::is_regular_file(input, ec)) {
+        inputs.push_back({ input, input.stem() });
+    } else {
+        IMP_LOG_WARN("Skipping missing input: %s", input.string().c_str());
+    }
+}
+
+bool BatchExporter::FindDuplicateOutputs(std::vector<Input> const& inputs, std::filesystem::path const& outputDirectory, ExportFormat format)
+{
+    std::unordered_map<std::string, std::filesystem::path const*> sources;
+    bool found = false;
+    for (Input const& input : inputs) {
+        std::filesystem::path outputPath = (outputDirectory / input.output).lexically_normal();
+        outputPath += ModelExporter::GetExtension(format);
+        auto [it, inserted] = sources.emplace(outputPath.string(), &input.source);
+        if (!inserted) {
+            IMP_LOG_ERROR("%s and %s would both be exported to %s", it->second->string().c_str(), input.source.string().c_str(), outputPath.string().c_str());
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool BatchExporter::ExportFile(Input const& input, std::filesystem::path const& outputDirectory, ExportFormat format, ModelRecolor const* recolor)
+{
+    ModelData model;
+    std::string errorMessage;
+    if (!ModelLoader::LoadFromFile(model, input.source, errorMessage)) {
+        if (errorMessage.empty()) {
+            errorMessage = "Failed to load model: " + input.source.string();
+        }
+        IMP_LOG_ERROR("%s", errorMessage.c_str());
+        return false;
+    }
+    if (recolor) {
+        recolor->Apply(model);
+    }
+
+    std::filesystem::path outputPath = outputDirectory / input.output;
+    outputPath += ModelExporter::GetExtension(format);
+    std::error_code ec;
+    std::filesystem::create_directories(outputPath.parent_path(), ec);
+    if (!ModelExporter::Export(model, outputPath, format)) {
+        IMP_LOG_ERROR("Failed to export %s to %s", input.source.string().c_str(), outputPath.string().c_str());
+        return false;
+    }
+    return true;
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ModelExporter.h"
+#include "ModelRecolor.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace imp {
+// Headless conversion entry point, used when the viewer is started with
+//   modelviewer --export <mqo|dat|glb> <output-directory> [options] <input>...
+// Inputs may be model files or directories, which are searched recursively.
+// Models found in a directory keep their path below it in the output
+// directory, and the export is refused if two inputs would still be written
+// to the same file.
+// Options are --recolor and --retexture, each taking a list of find=replace
+// pairs that is applied to every model before it is written.
+class BatchExporter {
+public:
+    static bool IsBatchCommand(int argc, char** argv);
+    static int Run(int argc, char** argv);
+
+private:
+    struct Input {
+        std::filesystem::path source;
+        // Relative to the output directory, without the extension.
+        std::filesystem::path output;
+    };
+
+    static void PrintUsage();
+    static void CollectInputs(std::filesystem::path const& input, std::vector<Input>& inputs);
+    static bool FindDuplicateOutputs(std::vector<Input> const& inputs, std::filesystem::path const& outputDirectory, ExportFormat format);
+    static bool ExportFile(Input const& input, std::filesystem::path const& outputDirectory, ExportFormat format, ModelRecolor const* recolor);
+};
+}
@@ -135,6 +135,14 @@ static void ReorderFromLE(T& value)
     }
 }
 
+template<typename T>
+static void ReorderToLE(T& value)
+{
+    if constexpr (IsBigEndian() && sizeof(T) > 1) {
+        DoByteReorder(value);
+    }
+}
+
 template<typename T>
 static void ReorderArrFromLE(T* arr, uint64_t count)
 {
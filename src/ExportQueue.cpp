@@ -0,0 +1,61 @@
+#include "ExportQueue.h"
+
+namespace imp {
+ExportQueue::ExportQueue()
+    : m_worker(&ExportQueue::WorkerLoop, this)
+{
+    // Do nothing.
+}
+
+ExportQueue::~ExportQueue()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_one();
+    // Anything still queued is drained before the worker exits so closing
+    // the viewer does not silently drop an export the user asked for.
+    m_worker.join();
+}
+
+std::shared_ptr<ExportJob> ExportQueue::Enqueue(ModelData const& model, std::filesystem::path const& path, ExportFormat format)
+{
+    auto job = std::make_shared<ExportJob>();
+    job->model = std::make_shared<ModelData const>(model);
+    job->path = path;
+    job->format = format;
+    {
+        std::lock_guard lock(m_mutex);
+        m_pending.push_back(job);
+    }
+    m_condition.notify_one();
+    return job;
+}
+
+void ExportQueue::WorkerLoop()
+{
+    while (true) {
+        std::shared_ptr<ExportJob> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] {
+                return m_stopping || !m_pending.empty();
+            });
+            if (m_pending.empty()) {
+                return;
+            }
+            job = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+
+        job->state.store(ExportJobState::Running, std::memory_order_release);
+        bool success = ModelExporter::Export(*job->model, job->path, job->format, &job->progress);
+        job->progress.store(1.0f, std::memory_order_relaxed);
+        job->state.store(success ? ExportJobState::Succeeded : ExportJobState::Failed, std::memory_order_release);
+        // The snapshot is no longer needed once written, don't keep it
+        // alive for as long as the UI shows the finished entry.
+        job->model.reset();
+    }
+}
+}
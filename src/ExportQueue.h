@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ModelExporter.h"
+#include "Utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace imp {
+enum class ExportJobState : uint8_t {
+    Queued,
+    Running,
+    Succeeded,
+    Failed
+};
+
+struct ExportJob {
+    std::shared_ptr<ModelData const> model;
+    std::filesystem::path path;
+    ExportFormat format;
+    std::atomic<float> progress { 0.0f };
+    std::atomic<ExportJobState> state { ExportJobState::Queued };
+
+    bool IsFinished() const
+    {
+        ExportJobState current = state.load(std::memory_order_acquire);
+        return current == ExportJobState::Succeeded || current == ExportJobState::Failed;
+    }
+};
+
+// Runs exports one after another on a single worker thread. Jobs hold their
+// own copy of the model, so the viewer is free to load something else while
+// an export is still being written.
+class ExportQueue {
+public:
+    ExportQueue();
+    ~ExportQueue();
+
+    MAKE_NON_COPYABLE(ExportQueue);
+
+    std::shared_ptr<ExportJob> Enqueue(ModelData const& model, std::filesystem::path const& path, ExportFormat format);
+
+private:
+    void WorkerLoop();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::shared_ptr<ExportJob>> m_pending;
+    bool m_stopping { false };
+    std::thread m_worker;
+};
+}
@@ -0,0 +1,114 @@
+#include "FileWatcher.h"
+
+#ifdef IMP_PLATFORM_LINUX
+#    include <poll.h>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+namespace imp {
+// How long the file has to stay untouched before a change is reported.
+constexpr std::chrono::milliseconds kSettleTime { 150 };
+// How often the watch thread checks whether it has been asked to stop.
+constexpr std::chrono::milliseconds kPollInterval { 250 };
+
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+void FileWatcher::Watch(std::filesystem::path const& filePath)
+{
+    Stop();
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_changed.store(false, std::memory_order_relaxed);
+    m_thread = std::thread(&FileWatcher::WatchLoop, this, filePath);
+}
+
+void FileWatcher::Stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopping.store(true, std::memory_order_relaxed);
+    m_thread.join();
+}
+
+bool FileWatcher::ConsumeChange()
+{
+    if (!m_changed.load(std::memory_order_acquire)) {
+        return false;
+    }
+    auto lastChange = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_lastChangeTime.load(std::memory_order_relaxed)));
+    if (std::chrono::steady_clock::now() - lastChange < kSettleTime) {
+        return false;
+    }
+    return m_changed.exchange(false, std::memory_order_acq_rel);
+}
+
+void FileWatcher::MarkChanged()
+{
+    m_lastChangeTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    m_changed.store(true, std::memory_order_release);
+}
+
+#ifdef IMP_PLATFORM_LINUX
+void FileWatcher::WatchLoop(std::filesystem::path filePath)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        IMP_LOG_WARN("Unable to watch %s for changes", filePath.string().c_str());
+        return;
+    }
+
+    // Editors commonly save by writing a temporary file and renaming it over
+    // the original, which replaces the inode, so the directory is watched
+    // rather than the file itself.
+    std::filesystem::path directory = filePath.parent_path();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    std::string fileName = filePath.filename().string();
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        IMP_LOG_WARN("Unable to watch %s for changes", filePath.string().c_str());
+        close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    pollfd pollDescriptor { fd, POLLIN, 0 };
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (poll(&pollDescriptor, 1, static_cast<int>(kPollInterval.count())) <= 0) {
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < length;) {
+                auto const* event = reinterpret_cast<inotify_event const*>(buffer + offset);
+                if (event->len > 0 && fileName == event->name) {
+                    MarkChanged();
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+    close(fd);
+}
+#else
+void FileWatcher::WatchLoop(std::filesystem::path filePath)
+{
+    std::error_code error;
+    auto lastWriteTime = std::filesystem::last_write_time(filePath, error);
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(kPollInterval);
+
+        auto writeTime = std::filesystem::last_write_time(filePath, error);
+        if (!error && writeTime != lastWriteTime) {
+            lastWriteTime = writeTime;
+            MarkChanged();
+        }
+    }
+}
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace imp {
+// Watches a single file for modifications on a background thread. Uses
+// inotify on Linux and falls back to polling the modification time on other
+// platforms. Changes are reported once the file has been quiet for a short
+// while, so an editor writing the file in several steps only triggers one
+// reload.
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    MAKE_NON_COPYABLE(FileWatcher);
+
+    void Watch(std::filesystem::path const& filePath);
+    void Stop();
+
+    // Returns true once per settled change of the watched file.
+    bool ConsumeChange();
+
+private:
+    void WatchLoop(std::filesystem::path filePath);
+    void MarkChanged();
+
+    std::thread m_thread;
+    std::atomic<bool> m_stopping { false };
+    std::atomic<bool> m_changed { false };
+    std::atomic<std::chrono::steady_clock::rep> m_lastChangeTime { 0 };
+};
+}
@@ -97,12 +97,6 @@ public:
     friend class ModelLoader;
 
 private:
-    static void WriteHeader(std::ofstream& file);
-    void WriteScene(std::ofstream& file) const;
-    void WriteMaterials(std::ofstream& file) const;
-    void WriteObjects(std::ofstream& file) const;
-    static void WriteObject(std::ofstream& file, MQOObject const& object);
-
     MQOScene m_scene;
     std::vector<MQOObject> m_objects;
     std::vector<MQOMaterial> m_materials;
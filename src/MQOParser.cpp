@@ -1,12 +1,165 @@
 #include "MQOParser.h"
 
+#include "TextScan.h"
+#include "ThreadBudget.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <thread>
+
 namespace imp {
+// Sections shorter than this are not worth the thread start-up cost.
+constexpr int32_t kParallelSectionThreshold = 16384;
+constexpr int32_t kMinLinesPerChunk = 4096;
+// Faces with more corners than this fail the load.
+constexpr int32_t kMaxFaceVertices = 64;
+
+// MQO lists face corners in the opposite winding to ours, so each triangle
+// is stored back to front.
+static void EmitTriangle(int32_t a, int32_t b, int32_t c, int32_t materialIndex, std::vector<MQOFace>& faces)
+{
+    MQOFace& face = faces.emplace_back();
+    face.v1 = c;
+    face.v2 = b;
+    face.v3 = a;
+    face.materialIndex = materialIndex;
+}
 
-// TODO(Waleed): Check if its valid integer we are parsing when we are using std::stoi
+static float Cross2D(float const* o, float const* a, float const* b)
+{
+    return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
 
-MQOParser::MQOParser(std::filesystem::path const& filePath)
+// Triangulates a polygon into faces using only stack storage. The polygon is
+// projected onto the plane of its Newell normal; convex polygons are fanned
+// from the first corner and anything else is ear clipped. Polygons that
+// cannot be projected (bad indices, zero area) or that have no ear left
+// (self-intersecting) fall back to a fan so no face is silently dropped.
+static void TriangulateFace(int32_t const* indices, int32_t count, int32_t materialIndex, std::vector<MQOVertex> const& vertices, std::vector<MQOFace>& faces)
 {
-    m_file.open(filePath, std::ios::in | std::ios::binary);
+    if (count == 3) {
+        EmitTriangle(indices[0], indices[1], indices[2], materialIndex, faces);
+        return;
+    }
+
+    auto fan = [&](int32_t const* polygon, int32_t polygonCount) {
+        for (int32_t i = 1; i + 1 < polygonCount; ++i) {
+            EmitTriangle(polygon[0], polygon[i], polygon[i + 1], materialIndex, faces);
+        }
+    };
+
+    float normal[3] = { 0.0f, 0.0f, 0.0f };
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t current = indices[i];
+        int32_t next = indices[(i + 1) % count];
+        if (current < 0 || next < 0 || current >= static_cast<int32_t>(vertices.size()) || next >= static_cast<int32_t>(vertices.size())) {
+            fan(indices, count);
+            return;
+        }
+        MQOVertex const& a = vertices[current];
+        MQOVertex const& b = vertices[next];
+        normal[0] += (a.y - b.y) * (a.z + b.z);
+        normal[1] += (a.z - b.z) * (a.x + b.x);
+        normal[2] += (a.x - b.x) * (a.y + b.y);
+    }
+
+    // Drop the dominant axis of the normal and keep the other two, ordered so
+    // the projected polygon winds counter-clockwise.
+    int32_t axis = 2;
+    if (std::abs(normal[0]) >= std::abs(normal[1]) && std::abs(normal[0]) >= std::abs(normal[2])) {
+        axis = 0;
+    } else if (std::abs(normal[1]) >= std::abs(normal[2])) {
+        axis = 1;
+    }
+    if (normal[axis] == 0.0f) {
+        fan(indices, count);
+        return;
+    }
+    int32_t u = (axis + 1) % 3;
+    int32_t v = (axis + 2) % 3;
+    if (normal[axis] < 0.0f) {
+        std::swap(u, v);
+    }
+
+    float points[kMaxFaceVertices][2];
+    for (int32_t i = 0; i < count; ++i) {
+        MQOVertex const& vertex = vertices[indices[i]];
+        float const position[3] = { vertex.x, vertex.y, vertex.z };
+        points[i][0] = position[u];
+        points[i][1] = position[v];
+    }
+
+    bool convex = true;
+    for (int32_t i = 0; i < count && convex; ++i) {
+        convex = Cross2D(points[i], points[(i + 1) % count], points[(i + 2) % count]) >= 0.0f;
+    }
+    if (convex) {
+        fan(indices, count);
+        return;
+    }
+
+    int32_t remaining[kMaxFaceVertices];
+    int32_t remainingCount = count;
+    for (int32_t i = 0; i < count; ++i) {
+        remaining[i] = i;
+    }
+
+    while (remainingCount > 3) {
+        bool clipped = false;
+        for (int32_t i = 0; i < remainingCount && !clipped; ++i) {
+            int32_t prev = remaining[(i + remainingCount - 1) % remainingCount];
+            int32_t ear = remaining[i];
+            int32_t next = remaining[(i + 1) % remainingCount];
+            if (Cross2D(points[prev], points[ear], points[next]) <= 0.0f) {
+                continue;
+            }
+
+            bool containsPoint = false;
+            for (int32_t j = 0; j < remainingCount && !containsPoint; ++j) {
+                int32_t other = remaining[j];
+                if (other == prev || other == ear || other == next) {
+                    continue;
+                }
+                containsPoint = Cross2D(points[prev], points[ear], points[other]) >= 0.0f
+                    && Cross2D(points[ear], points[next], points[other]) >= 0.0f
+                    && Cross2D(points[next], points[prev], points[other]) >= 0.0f;
+            }
+            if (containsPoint) {
+                continue;
+            }
+
+            EmitTriangle(indices[prev], indices[ear], indices[next], materialIndex, faces);
+            std::copy(remaining + i + 1, remaining + remainingCount, remaining + i);
+            --remainingCount;
+            clipped = true;
+        }
+        if (!clipped) {
+            break;
+        }
+    }
+
+    int32_t polygon[kMaxFaceVertices];
+    for (int32_t i = 0; i < remainingCount; ++i) {
+        polygon[i] = indices[remaining[i]];
+    }
+    fan(polygon, remainingCount);
+}
+
+MQOParser::MQOParser(std::filesystem::path const& filePath, FileAccess access)
+    : m_mappedFile(filePath, access)
+    , m_good(m_mappedFile.Good())
+    , m_text(m_mappedFile.GetView())
+{
+    // Do nothing.
+}
+
+MQOParser::MQOParser(char const* text, size_t length)
+    : m_good(true)
+    , m_text(text, length)
+{
+    // Do nothing.
 }
 
 bool MQOParser::Parse(MQOFile& mqoFile)
@@ -24,7 +177,7 @@ bool MQOParser::Parse(MQOFile& mqoFile)
             continue;
         }
 
-        if (m_currentLine.find("Scene ") == 0) {
+        if (m_currentLine.starts_with("Scene ")) {
             MQOScene scene;
             if (!ParseScene(scene)) {
                 return false;
@@ -33,7 +186,7 @@ bool MQOParser::Parse(MQOFile& mqoFile)
             continue;
         }
 
-        if (m_currentLine.find("Material ") != std::string::npos) {
+        if (m_currentLine.find("Material ") != std::string_view::npos) {
             std::vector<MQOMaterial> materials;
             if (!ParseMaterials(materials)) {
                 return false;
@@ -45,7 +198,7 @@ bool MQOParser::Parse(MQOFile& mqoFile)
             continue;
         }
 
-        if (m_currentLine.find("Object ") == 0) {
+        if (m_currentLine.starts_with("Object ")) {
             MQOObject object;
             if (!ParseObject(object)) {
                 return false;
@@ -54,7 +207,7 @@ bool MQOParser::Parse(MQOFile& mqoFile)
             continue;
         }
 
-        if (m_currentLine.find('{') != std::string::npos) {
+        if (m_currentLine.find('{') != std::string_view::npos) {
             m_position = m_currentLine.find('{') + 1;
             SkipToMatchingBrace();
         }
@@ -65,106 +218,40 @@ bool MQOParser::Parse(MQOFile& mqoFile)
 
 bool MQOParser::ParseScene(MQOScene& scene)
 {
-    if (m_currentLine.find('{') == std::string::npos) {
-        if (!NextLine() || m_currentLine.find('{') == std::string::npos) {
+    if (m_currentLine.find('{') == std::string_view::npos) {
+        if (!NextLine() || m_currentLine.find('{') == std::string_view::npos) {
             return SetError("Expected opening brace for Scene section");
         }
     }
 
     while (NextLine()) {
-        if (m_currentLine.find('}') != std::string::npos) {
+        if (m_currentLine.find('}') != std::string_view::npos) {
             return true;
         }
 
-        m_position = 0;
-        SkipWhitespace();
-
-        if (m_currentLine.find("pos ") == 0) {
-            m_position = 4;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.posX = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.posY = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.posZ = std::stof(token.value);
-        } else if (m_currentLine.find("lookat ") == 0) {
-            m_position = 7;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.lookatX = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.lookatY = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.lookatZ = std::stof(token.value);
-        } else if (m_currentLine.find("head ") == 0) {
-            m_position = 5;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.head = std::stof(token.value);
-        } else if (m_currentLine.find("pich ") == 0) {
-            m_position = 5;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
+        if (ConsumeKeyword("pos ")) {
+            if (!ExpectFloat(scene.posX) || !ExpectFloat(scene.posY)) {
                 continue;
             }
-            scene.pitch = std::stof(token.value);
-        } else if (m_currentLine.find("ortho ") == 0) {
-            m_position = 6;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.ortho = std::stoi(token.value);
-        } else if (m_currentLine.find("zoom2 ") == 0) {
-            m_position = 6;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.zoom2 = std::stof(token.value);
-        } else if (m_currentLine.find("amb ") == 0) {
-            m_position = 4;
-            Token token;
-
-            if (!Expect(TokenType::NUMBER, token)) {
+            ExpectFloat(scene.posZ);
+        } else if (ConsumeKeyword("lookat ")) {
+            if (!ExpectFloat(scene.lookatX) || !ExpectFloat(scene.lookatY)) {
                 continue;
             }
-            scene.ambR = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
-                continue;
-            }
-            scene.ambG = std::stof(token.value);
-
-            if (!Expect(TokenType::NUMBER, token)) {
+            ExpectFloat(scene.lookatZ);
+        } else if (ConsumeKeyword("head ")) {
+            ExpectFloat(scene.head);
+        } else if (ConsumeKeyword("pich ")) {
+            ExpectFloat(scene.pitch);
+        } else if (ConsumeKeyword("ortho ")) {
+            ExpectInt(scene.ortho);
+        } else if (ConsumeKeyword("zoom2 ")) {
+            ExpectFloat(scene.zoom2);
+        } else if (ConsumeKeyword("amb ")) {
+            if (!ExpectFloat(scene.ambR) || !ExpectFloat(scene.ambG)) {
                 continue;
             }
-            scene.ambB = std::stof(token.value);
+            ExpectFloat(scene.ambB);
         }
     }
 
@@ -177,19 +264,20 @@ bool MQOParser::ParseMaterials(std::vector<MQOMaterial>& materials)
     if (!Expect(TokenType::IDENTIFIER, token) || token.value != "Material") {
         return SetError("Expected 'Material' keyword");
     }
-    Token count;
-    if (!Expect(TokenType::NUMBER, count)) {
+    int32_t materialCount;
+    if (!ExpectInt(materialCount)) {
         return SetError("Expected material count");
     }
     Token lbrace;
     if (!Expect(TokenType::SYMBOL, lbrace) || !lbrace.IsSymbol('{')) {
         return SetError("Expected opening brace for Material section");
     }
-    int32_t materialCount = std::stoi(count.value);
-    materials.reserve(materialCount);
+    if (materialCount > 0) {
+        materials.reserve(materialCount);
+    }
 
     while (NextLine()) {
-        if (m_currentLine.find('}') != std::string::npos) {
+        if (m_currentLine.find('}') != std::string_view::npos) {
             return true;
         }
 
@@ -206,12 +294,12 @@ bool MQOParser::ParseObject(MQOObject& object)
 {
     size_t firstQuote = m_currentLine.find('"');
     size_t lastQuote = m_currentLine.find('"', firstQuote + 1);
-    if (firstQuote != std::string::npos && lastQuote != std::string::npos) {
+    if (firstQuote != std::string_view::npos && lastQuote != std::string_view::npos) {
         object.name = m_currentLine.substr(firstQuote + 1, lastQuote - firstQuote - 1);
     }
 
-    if (m_currentLine.find('{') == std::string::npos) {
-        if (!NextLine() || m_currentLine.find('{') == std::string::npos) {
+    if (m_currentLine.find('{') == std::string_view::npos) {
+        if (!NextLine() || m_currentLine.find('{') == std::string_view::npos) {
             return SetError("Expected opening brace for Object section");
         }
     }
@@ -221,115 +309,51 @@ bool MQOParser::ParseObject(MQOObject& object)
             return true;
         }
 
-        m_position = 0;
-        SkipWhitespace();
-
-        if (m_currentLine.find("\tdepth ") == 0) {
-            m_position = 7;
-            if (Token token; Expect(TokenType::NUMBER, token)) {
-                object.depth = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tfolding ") == 0) {
-            m_position = 10;
-            if (Token token; Expect(TokenType::NUMBER, token)) {
-                object.folding = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tscale ") == 0) {
-            m_position = 8;
-            Token token;
-
-            if (Expect(TokenType::NUMBER, token)) {
-                object.scaleX = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.scaleY = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.scaleZ = std::stof(token.value);
-            }
-        } else if (m_currentLine.find("\trotation ") == 0) {
-            m_position = 11;
-            Token token;
-
-            if (Expect(TokenType::NUMBER, token)) {
-                object.rotationX = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.rotationY = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.rotationZ = std::stof(token.value);
-            }
-        } else if (m_currentLine.find("\ttranslation ") == 0) {
-            m_position = 14;
-            Token token;
-
-            if (Expect(TokenType::NUMBER, token)) {
-                object.translationX = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.translationY = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.translationZ = std::stof(token.value);
-            }
-        } else if (m_currentLine.find("\tvisible ") == 0) {
-            m_position = 10;
-            Token token;
-            if (Expect(TokenType::NUMBER, token)) {
-                object.visible = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tlocking ") == 0) {
-            m_position = 10;
-            Token token;
-            if (Expect(TokenType::NUMBER, token)) {
-                object.locking = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tshading ") == 0) {
-            m_position = 10;
-            Token token;
-            if (Expect(TokenType::NUMBER, token)) {
-                object.shading = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tfacet ") == 0) {
-            m_position = 8;
-            Token token;
-            if (Expect(TokenType::NUMBER, token)) {
-                object.facet = std::stof(token.value);
-            }
-        } else if (m_currentLine.find("\tcolor ") == 0) {
-            m_position = 8;
-
-            Token token;
-            if (Expect(TokenType::NUMBER, token)) {
-                object.colorR = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.colorG = std::stof(token.value);
-            }
-            if (Expect(TokenType::NUMBER, token)) {
-                object.colorB = std::stof(token.value);
-            }
-        } else if (m_currentLine.find("\tcolor_type ") == 0) {
-            m_position = 13;
-            if (Token token; Expect(TokenType::NUMBER, token)) {
-                object.colorType = std::stoi(token.value);
-            }
-        } else if (m_currentLine.find("\tvertex ") == 0) {
+        if (ConsumeKeyword("depth ")) {
+            ExpectInt(object.depth);
+        } else if (ConsumeKeyword("folding ")) {
+            ExpectInt(object.folding);
+        } else if (ConsumeKeyword("scale ")) {
+            ExpectFloat(object.scaleX);
+            ExpectFloat(object.scaleY);
+            ExpectFloat(object.scaleZ);
+        } else if (ConsumeKeyword("rotation ")) {
+            ExpectFloat(object.rotationX);
+            ExpectFloat(object.rotationY);
+            ExpectFloat(object.rotationZ);
+        } else if (ConsumeKeyword("translation ")) {
+            ExpectFloat(object.translationX);
+            ExpectFloat(object.translationY);
+            ExpectFloat(object.translationZ);
+        } else if (ConsumeKeyword("visible ")) {
+            ExpectInt(object.visible);
+        } else if (ConsumeKeyword("locking ")) {
+            ExpectInt(object.locking);
+        } else if (ConsumeKeyword("shading ")) {
+            ExpectInt(object.shading);
+        } else if (ConsumeKeyword("facet ")) {
+            ExpectFloat(object.facet);
+        } else if (ConsumeKeyword("color ")) {
+            ExpectFloat(object.colorR);
+            ExpectFloat(object.colorG);
+            ExpectFloat(object.colorB);
+        } else if (ConsumeKeyword("color_type ")) {
+            ExpectInt(object.colorType);
+        } else if (m_currentLine.starts_with("\tvertex ")) {
             if (!ParseVertices(object.vertices)) {
                 return false;
             }
-        } else if (m_currentLine.find("\tface ") == 0) {
-            if (!ParseFaces(object.faces)) {
+        } else if (m_currentLine.starts_with("\tface ")) {
+            if (!ParseFaces(object.faces, object.vertices)) {
                 return false;
             }
-        } else if (m_currentLine.find("\tvertexattr") != std::string::npos) {
-            if (m_currentLine.find('{') != std::string::npos) {
+        } else if (m_currentLine.find("\tvertexattr") != std::string_view::npos) {
+            if (m_currentLine.find('{') != std::string_view::npos) {
                 if (!ParseVertexAttr(object)) {
                     return false;
                 }
             }
-        } else if (m_currentLine.find('{') != std::string::npos) {
+        } else if (m_currentLine.find('{') != std::string_view::npos) {
             m_position = m_currentLine.find('{') + 1;
             SkipToMatchingBrace();
         }
@@ -339,18 +363,18 @@ bool MQOParser::ParseObject(MQOObject& object)
 
 bool MQOParser::ParseVertices(std::vector<MQOVertex>& vertices)
 {
-    size_t countPos = m_currentLine.find(' ');
-    if (countPos != std::string::npos) {
-        size_t bracePos = m_currentLine.find('{', countPos);
-        if (bracePos != std::string::npos) {
-            std::string countStr = m_currentLine.substr(countPos, bracePos - countPos);
-            int32_t vertexCount = std::stoi(countStr);
-            vertices.reserve(vertexCount);
-        }
+    int32_t vertexCount = ParseSectionCount();
+    if (vertexCount >= kParallelSectionThreshold && ParseSectionParallel(vertices, vertexCount, [](MQOParser& parser, std::vector<MQOVertex>& out) {
+            return parser.ParseVertex(out.emplace_back());
+        })) {
+        return true;
+    }
+    if (vertexCount > 0) {
+        vertices.reserve(vertexCount);
     }
 
     while (NextLine()) {
-        if (m_currentLine == "\t}" || m_currentLine.find("\t}") != std::string::npos) {
+        if (m_currentLine == "\t}" || m_currentLine.find("\t}") != std::string_view::npos) {
             return true;
         }
 
@@ -363,35 +387,122 @@ bool MQOParser::ParseVertices(std::vector<MQOVertex>& vertices)
     return SetError("Unexpected end of file while parsing Vertex section");
 }
 
-bool MQOParser::ParseFaces(std::vector<MQOFace>& faces)
+bool MQOParser::ParseFaces(std::vector<MQOFace>& faces, std::vector<MQOVertex> const& vertices)
 {
-    size_t countPos = m_currentLine.find(' ');
-    if (countPos != std::string::npos) {
-        size_t bracePos = m_currentLine.find('{', countPos);
-        if (bracePos != std::string::npos) {
-            std::string countStr = m_currentLine.substr(countPos, bracePos - countPos);
-            int32_t faceCount = std::stoi(countStr);
-            faces.reserve(faceCount);
-        }
+    int32_t faceCount = ParseSectionCount();
+    if (faceCount >= kParallelSectionThreshold && ParseSectionParallel(faces, faceCount, [&vertices](MQOParser& parser, std::vector<MQOFace>& out) {
+            return parser.ParseFace(out, vertices);
+        })) {
+        return true;
+    }
+    if (faceCount > 0) {
+        faces.reserve(faceCount);
     }
 
-    while (NextLine()) {
-        if (m_currentLine == "\t}" || m_currentLine.find("\t}") != std::string::npos) {
+    // Lines that do not parse are skipped, but a face the parser cannot
+    // represent is an error, so the model does not load with a hole in it.
+    for (int32_t faceIndex = 0; NextLine(); ++faceIndex) {
+        if (m_currentLine == "\t}" || m_currentLine.find("\t}") != std::string_view::npos) {
             return true;
         }
 
         m_position = 0;
         SkipWhitespace();
-        if (MQOFace face; ParseFace(face)) {
-            faces.push_back(face);
+        if (!ParseFace(faces, vertices) && !m_errorMessage.empty()) {
+            return SetError("Face " + std::to_string(faceIndex) + ": " + m_errorMessage);
         }
     }
     return SetError("Unexpected end of file while parsing Face section");
 }
 
+// The section header declares how many lines follow, so the lines can be
+// split into ranges up front and each range parsed by its own sub-parser.
+// Each range fills its own vector, since a line may yield any number of
+// elements (n-gons become several triangles), and the ranges are joined in
+// order at the end. Anything unexpected (a short section, a line that does
+// not parse) makes this bail out without consuming input so the sequential
+// path, which knows how to skip bad lines, takes over.
+template<typename T, typename ParseLine>
+bool MQOParser::ParseSectionParallel(std::vector<T>& elements, int32_t count, ParseLine const& parseLine)
+{
+    // Threads come out of the shared budget, so inside a batch export, which
+    // already keeps every core busy, sections are parsed line by line.
+    ThreadBudget budget(static_cast<uint32_t>(std::max(count / kMinLinesPerChunk - 1, 0)));
+    int32_t chunkCount = std::clamp<int32_t>(count / kMinLinesPerChunk, 1, static_cast<int32_t>(budget.GetCount()) + 1);
+    if (chunkCount < 2) {
+        return false;
+    }
+    int32_t linesPerChunk = (count + chunkCount - 1) / chunkCount;
+
+    std::vector<size_t> chunkOffsets;
+    chunkOffsets.reserve(chunkCount + 1);
+    size_t offset = m_offset;
+    for (int32_t line = 0; line < count; ++line) {
+        if (offset >= m_text.size()) {
+            return false;
+        }
+        if (line % linesPerChunk == 0) {
+            chunkOffsets.push_back(offset);
+        }
+        char const* newline = text::FindNewline(m_text.data() + offset, m_text.data() + m_text.size());
+        if (newline == m_text.data() + m_text.size()) {
+            return false;
+        }
+        offset = static_cast<size_t>(newline - m_text.data()) + 1;
+    }
+    size_t sectionEnd = offset;
+    chunkOffsets.push_back(sectionEnd);
+
+    std::vector<std::vector<T>> chunkElements(chunkOffsets.size() - 1);
+    std::atomic<bool> failed { false };
+    auto parseChunk = [&](int32_t chunk) {
+        int32_t first = chunk * linesPerChunk;
+        int32_t last = std::min(first + linesPerChunk, count);
+
+        std::vector<T>& out = chunkElements[chunk];
+        out.reserve(last - first);
+        MQOParser parser(m_text.data() + chunkOffsets[chunk], chunkOffsets[chunk + 1] - chunkOffsets[chunk]);
+        for (int32_t i = first; i < last; ++i) {
+            if (failed.load(std::memory_order_relaxed) || !parser.NextLine() || parser.m_currentLine.find("\t}") != std::string_view::npos
+                || !parseLine(parser, out)) {
+                failed.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunkCount - 1);
+    for (int32_t chunk = 1; chunk < static_cast<int32_t>(chunkOffsets.size()) - 1; ++chunk) {
+        workers.emplace_back(parseChunk, chunk);
+    }
+    parseChunk(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // The declared count must be followed directly by the closing brace,
+    // otherwise the header lied and the section is parsed line by line.
+    m_offset = sectionEnd;
+    if (failed || !NextLine() || m_currentLine.find("\t}") == std::string_view::npos) {
+        m_offset = chunkOffsets.front();
+        return false;
+    }
+
+    size_t total = 0;
+    for (auto const& out : chunkElements) {
+        total += out.size();
+    }
+    elements.reserve(elements.size() + total);
+    for (auto const& out : chunkElements) {
+        elements.insert(elements.end(), out.begin(), out.end());
+    }
+    return true;
+}
+
 bool MQOParser::ParseVertexAttr(MQOObject& object)
 {
-    if (m_currentLine.find('{') != std::string::npos) {
+    if (m_currentLine.find('{') != std::string_view::npos) {
         m_position = m_currentLine.find('{') + 1;
     }
 
@@ -432,25 +543,8 @@ bool MQOParser::ParseVertexAttr(MQOObject& object)
             } else {
                 if (Token token = NextToken(); token.type == TokenType::IDENTIFIER) {
                     token = NextToken();
-                    if (token.IsSymbol('{')) {
-                        braceLevel++;
-                        int32_t sectionBraceLevel = 1;
-                        while (sectionBraceLevel > 0) {
-                            if (m_position >= m_currentLine.length()) {
-                                if (!NextLine()) {
-                                    return SetError("Unexpected end of file while parsing unknown section");
-                                }
-                                continue;
-                            }
-                            char c = m_currentLine[m_position++];
-                            if (c == '{') {
-                                sectionBraceLevel++;
-                                braceLevel++;
-                            } else if (c == '}') {
-                                sectionBraceLevel--;
-                                braceLevel--;
-                            }
-                        }
+                    if (token.IsSymbol('{') && !SkipToMatchingBrace()) {
+                        return SetError("Unexpected end of file while parsing unknown section");
                     }
                 } else {
                     m_position = m_currentLine.length();
@@ -459,11 +553,10 @@ bool MQOParser::ParseVertexAttr(MQOObject& object)
         } else {
             Token indexToken = NextToken();
             if (indexToken.type == TokenType::NUMBER) {
-                Token weightToken = NextToken();
-                if (weightToken.type == TokenType::NUMBER) {
-                    int32_t index = std::stoi(indexToken.value);
-                    float weight = std::stof(weightToken.value);
-                    if (index >= 0 && index < object.vertices.size()) {
+                int32_t index;
+                float weight;
+                if (ToInt(indexToken.value, index) && ExpectFloat(weight)) {
+                    if (index >= 0 && static_cast<size_t>(index) < object.vertices.size()) {
                         object.vertices[index].weit = weight;
                     }
                 }
@@ -479,37 +572,23 @@ bool MQOParser::ParseVertexAttr(MQOObject& object)
 
 bool MQOParser::ParseVertex(MQOVertex& vertex)
 {
-    Token token;
-    if (!Expect(TokenType::NUMBER, token)) {
-        return false;
-    }
-    vertex.x = std::stof(token.value);
-
-    if (!Expect(TokenType::NUMBER, token)) {
-        return false;
-    }
-    vertex.y = std::stof(token.value);
-
-    if (!Expect(TokenType::NUMBER, token)) {
-        return false;
-    }
-    vertex.z = std::stof(token.value);
-    return true;
+    return ExpectFloat(vertex.x) && ExpectFloat(vertex.y) && ExpectFloat(vertex.z);
 }
 
-bool MQOParser::ParseFace(MQOFace& face)
+bool MQOParser::ParseFace(std::vector<MQOFace>& faces, std::vector<MQOVertex> const& vertices)
 {
-    Token token;
-    if (!Expect(TokenType::NUMBER, token)) {
+    int32_t vertexCount;
+    if (!ExpectInt(vertexCount)) {
         return false;
     }
-
-    int32_t vertexCount = std::stoi(token.value);
-    if (vertexCount != 3) {
-        SetError("Only triangles are supported. Found " + std::to_string(vertexCount) + "-sided polygon.");
+    if (vertexCount < 3) {
         return false;
     }
+    if (vertexCount > kMaxFaceVertices) {
+        return SetError("Only polygons with up to " + std::to_string(kMaxFaceVertices) + " sides are supported. Found " + std::to_string(vertexCount) + "-sided polygon.");
+    }
 
+    Token token;
     SkipWhitespace();
     if (!Expect(TokenType::IDENTIFIER, token) || token.value != "V") {
         return false;
@@ -521,20 +600,15 @@ bool MQOParser::ParseFace(MQOFace& face)
         return false;
     }
 
-    std::vector<int32_t> vertices;
+    int32_t indices[kMaxFaceVertices];
     for (int32_t i = 0; i < vertexCount; i++) {
         SkipWhitespace();
-        if (!Expect(TokenType::NUMBER, token)) {
+        if (!ExpectInt(indices[i])) {
             return false;
         }
-        vertices.push_back(std::stoi(token.value));
         SkipWhitespace();
     }
 
-    face.v1 = vertices[2];
-    face.v2 = vertices[1];
-    face.v3 = vertices[0];
-
     SkipWhitespace();
     token = NextToken();
     if (!token.IsSymbol(')')) {
@@ -552,18 +626,20 @@ bool MQOParser::ParseFace(MQOFace& face)
         return false;
     }
 
+    int32_t materialIndex;
     SkipWhitespace();
-    if (!Expect(TokenType::NUMBER, token)) {
+    if (!ExpectInt(materialIndex)) {
         return false;
     }
-    face.materialIndex = std::stoi(token.value);
 
     SkipWhitespace();
 
     token = NextToken();
     if (!token.IsSymbol(')')) {
-        return false; // NOLINT(*-simplify-boolean-expr)
+        return false;
     }
+
+    TriangulateFace(indices, vertexCount, materialIndex, vertices, faces);
     return true;
 }
 
@@ -573,7 +649,7 @@ bool MQOParser::ParseMaterial(MQOMaterial& material)
     if (!Expect(TokenType::STRING, token)) {
         return false;
     }
-    material.name = token.value;
+    material.name = std::string(token.value);
 
     while (m_position < m_currentLine.length()) {
         SkipWhitespace();
@@ -599,7 +675,7 @@ bool MQOParser::ParseMaterial(MQOMaterial& material)
             }
         }
 
-        std::string property = token.value;
+        std::string_view property = token.value;
         SkipWhitespace();
         token = NextToken();
         if (!token.IsSymbol('(')) {
@@ -607,74 +683,64 @@ bool MQOParser::ParseMaterial(MQOMaterial& material)
         }
         if (property == "shader") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectInt(material.shader)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.shader = std::stoi(token.value);
         } else if (property == "col") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.r)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.r = std::stof(token.value);
 
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.g)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.g = std::stof(token.value);
 
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.b)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.b = std::stof(token.value);
 
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.alpha)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.alpha = std::stof(token.value);
         } else if (property == "dif") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.diffuse)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.diffuse = std::stof(token.value);
         } else if (property == "amb") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.ambient)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.ambient = std::stof(token.value);
         } else if (property == "emi") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.emission)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.emission = std::stof(token.value);
         } else if (property == "spc") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.specular)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.specular = std::stof(token.value);
         } else if (property == "power") {
             SkipWhitespace();
-            if (!Expect(TokenType::NUMBER, token)) {
+            if (!ExpectFloat(material.power)) {
                 SkipToClosingParenthesis();
                 continue;
             }
-            material.power = std::stof(token.value);
         } else {
             SkipToClosingParenthesis();
         }
@@ -685,92 +751,102 @@ bool MQOParser::ParseMaterial(MQOMaterial& material)
 
 void MQOParser::SkipWhitespace()
 {
-    while (m_position < m_currentLine.length() && std::isspace(static_cast<unsigned char>(m_currentLine[m_position])) != 0) {
-        m_position++;
+    if (m_position >= m_currentLine.length()) {
+        return;
     }
+    char const* line = m_currentLine.data();
+    m_position = text::SkipSpaces(line + m_position, line + m_currentLine.length()) - line;
 }
 
 bool MQOParser::NextLine()
 {
-    if (std::getline(m_file, m_currentLine)) {
-        m_position = 0;
-        while (!m_currentLine.empty() && (m_currentLine.back() == '\r' || m_currentLine.back() == '\n')) {
-            m_currentLine.pop_back();
-        }
-        SkipWhitespace();
-        return true;
+    if (m_offset >= m_text.size()) {
+        return false;
     }
-    return false;
+
+    size_t lineStart = m_offset;
+    char const* textEnd = m_text.data() + m_text.size();
+    size_t lineEnd = text::FindNewline(m_text.data() + lineStart, textEnd) - m_text.data();
+    m_offset = lineEnd < m_text.size() ? lineEnd + 1 : m_text.size();
+
+    m_currentLine = m_text.substr(lineStart, lineEnd - lineStart);
+    while (!m_currentLine.empty() && (m_currentLine.back() == '\r' || m_currentLine.back() == '\n')) {
+        m_currentLine.remove_suffix(1);
+    }
+    m_position = 0;
+    SkipWhitespace();
+    return true;
 }
 
 Token MQOParser::NextToken()
 {
     if (m_position >= m_currentLine.length()) {
-        return { TokenType::ENDOFFILE, "" };
+        return { TokenType::ENDOFFILE, {} };
     }
 
     SkipWhitespace();
 
     if (m_position >= m_currentLine.length()) {
-        return { TokenType::ENDOFFILE, "" };
+        return { TokenType::ENDOFFILE, {} };
     }
 
+    auto isDigit = [this](size_t position) {
+        return position < m_currentLine.length() && std::isdigit(static_cast<unsigned char>(m_currentLine[position])) != 0;
+    };
+
+    size_t start = m_position;
     char c = m_currentLine[m_position];
     if (c == '"') {
         m_position++;
-        std::string value;
-        while (m_position < m_currentLine.length() && m_currentLine[m_position] != '"') {
-            value += m_currentLine[m_position++];
-        }
-        if (m_position < m_currentLine.length() && m_currentLine[m_position] == '"') {
-            m_position++;
+        size_t end = m_currentLine.find('"', m_position);
+        if (end == std::string_view::npos) {
+            end = m_currentLine.length();
         }
+        std::string_view value = m_currentLine.substr(m_position, end - m_position);
+        m_position = end < m_currentLine.length() ? end + 1 : end;
         return { TokenType::STRING, value };
     }
 
     if (c == '{' || c == '}' || c == '(' || c == ')') {
         m_position++;
-        return { TokenType::SYMBOL, std::string(1, c) };
+        return { TokenType::SYMBOL, m_currentLine.substr(start, 1) };
     }
 
     if (std::isdigit(static_cast<unsigned char>(c)) != 0 || c == '-' || c == '.') {
-        std::string value;
         if (c == '-') {
-            value += c;
             m_position++;
-            if (m_position >= m_currentLine.length() || std::isdigit(static_cast<unsigned char>(m_currentLine[m_position])) != 0 || m_currentLine[m_position] == '.') {
-                return { TokenType::SYMBOL, "-" };
+            if (!isDigit(m_position) && (m_position >= m_currentLine.length() || m_currentLine[m_position] != '.')) {
+                return { TokenType::SYMBOL, m_currentLine.substr(start, 1) };
             }
         }
-        while (m_position < m_currentLine.length() && std::isdigit(static_cast<unsigned char>(m_currentLine[m_position])) != 0) {
-            value += m_currentLine[m_position++];
+        while (isDigit(m_position)) {
+            m_position++;
         }
         if (m_position < m_currentLine.length() && m_currentLine[m_position] == '.') {
-            value += m_currentLine[m_position++];
-            while (m_position < m_currentLine.length() && std::isdigit(static_cast<unsigned char>(m_currentLine[m_position])) != 0) {
-                value += m_currentLine[m_position++];
+            m_position++;
+            while (isDigit(m_position)) {
+                m_position++;
             }
         }
 
         if (m_position < m_currentLine.length() && (m_currentLine[m_position] == 'e' || m_currentLine[m_position] == 'E')) {
-            value += m_currentLine[m_position++];
+            m_position++;
             if (m_position < m_currentLine.length() && (m_currentLine[m_position] == '+' || m_currentLine[m_position] == '-')) {
-                value += m_currentLine[m_position++];
+                m_position++;
             }
-            while (m_position < m_currentLine.length() && std::isdigit(static_cast<unsigned char>(m_currentLine[m_position])) != 0) {
-                value += m_currentLine[m_position++];
+            while (isDigit(m_position)) {
+                m_position++;
             }
         }
 
-        return { TokenType::NUMBER, value };
+        return { TokenType::NUMBER, m_currentLine.substr(start, m_position - start) };
     }
 
     if (std::isalpha(static_cast<unsigned char>(c)) != 0 || c == '_') {
-        std::string value;
         while (m_position < m_currentLine.length() && (std::isalnum(static_cast<unsigned char>(m_currentLine[m_position])) != 0 || m_currentLine[m_position] == '_')) {
-            value += m_currentLine[m_position++];
+            m_position++;
         }
-        return { TokenType::IDENTIFIER, value };
+        return { TokenType::IDENTIFIER, m_currentLine.substr(start, m_position - start) };
     }
     m_position++;
     return NextToken();
@@ -782,6 +858,62 @@ bool MQOParser::Expect(TokenType type, Token& token)
     return token.type == type;
 }
 
+bool MQOParser::ExpectFloat(float& value)
+{
+    Token token;
+    return Expect(TokenType::NUMBER, token) && ToFloat(token.value, value);
+}
+
+bool MQOParser::ExpectInt(int32_t& value)
+{
+    Token token;
+    return Expect(TokenType::NUMBER, token) && ToInt(token.value, value);
+}
+
+bool MQOParser::ToFloat(std::string_view text, float& value)
+{
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc();
+}
+
+bool MQOParser::ToInt(std::string_view text, int32_t& value)
+{
+    // Integers written as "1.0" by other tools are truncated like stoi did.
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc();
+}
+
+bool MQOParser::ConsumeKeyword(std::string_view keyword)
+{
+    if (m_currentLine.substr(m_position).starts_with(keyword)) {
+        m_position += keyword.length();
+        return true;
+    }
+    return false;
+}
+
+int32_t MQOParser::ParseSectionCount() const
+{
+    // Section headers look like "\tvertex 123 {".
+    size_t countPos = m_currentLine.find(' ', m_position);
+    if (countPos == std::string_view::npos) {
+        return -1;
+    }
+    size_t bracePos = m_currentLine.find('{', countPos);
+    if (bracePos == std::string_view::npos) {
+        return -1;
+    }
+    std::string_view countText = m_currentLine.substr(countPos, bracePos - countPos);
+    while (!countText.empty() && std::isspace(static_cast<unsigned char>(countText.front())) != 0) {
+        countText.remove_prefix(1);
+    }
+    int32_t count;
+    if (!ToInt(countText, count)) {
+        return -1;
+    }
+    return count;
+}
+
 void MQOParser::SkipToClosingBrace()
 {
     SkipToMatchingBrace();
@@ -802,22 +934,35 @@ void MQOParser::SkipToClosingParenthesis()
 
 bool MQOParser::SkipToMatchingBrace()
 {
+    // Scan the whole remaining buffer for braces rather than going line by
+    // line; unknown sections are skipped without being split into lines.
+    char const* textBegin = m_text.data();
+    char const* textEnd = textBegin + m_text.size();
+    char const* it = m_currentLine.data() + std::min(m_position, m_currentLine.length());
     int32_t braceLevel = 1;
-    while (braceLevel > 0) {
-        if (m_position >= m_currentLine.length()) {
-            if (!NextLine()) {
-                return false;
-            }
-            continue;
+    while (true) {
+        it = text::FindBrace(it, textEnd);
+        if (it == textEnd) {
+            m_offset = m_text.size();
+            m_currentLine = {};
+            m_position = 0;
+            return false;
         }
-
-        char c = m_currentLine[m_position++];
-        if (c == '{') {
-            braceLevel++;
-        } else if (c == '}') {
-            braceLevel--;
+        braceLevel += *it == '{' ? 1 : -1;
+        if (braceLevel == 0) {
+            break;
         }
+        ++it;
+    }
+
+    // Leave the parser on the line holding the closing brace, just past it.
+    char const* lineStart = it;
+    while (lineStart != textBegin && lineStart[-1] != '\n') {
+        --lineStart;
     }
+    m_offset = lineStart - textBegin;
+    NextLine();
+    m_position = (it - lineStart) + 1;
     return true;
 }
 
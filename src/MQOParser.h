@@ -1,10 +1,11 @@
 #pragma once
 
 #include "MQOFile.h"
+#include "MappedFile.h"
 
 #include <filesystem>
-#include <fstream>
 #include <string>
+#include <string_view>
 
 namespace imp {
 enum class TokenType : uint8_t {
@@ -15,9 +16,11 @@ enum class TokenType : uint8_t {
     ENDOFFILE
 };
 
+// Token values point into the parser's file mapping and are only valid for
+// as long as the parser is alive.
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
 
     bool IsSymbol(char symbol) const
     {
@@ -26,13 +29,13 @@ struct Token {
 };
 class MQOParser {
 public:
-    explicit MQOParser(std::filesystem::path const& filePath);
+    explicit MQOParser(std::filesystem::path const& filePath, FileAccess access = FileAccess::Mapped);
 
     bool Parse(MQOFile& mqoFile);
 
     bool Good() const
     {
-        return m_file.good();
+        return m_good;
     }
 
     std::string GetErrorMessage() const
@@ -41,28 +44,44 @@ public:
     }
 
 private:
+    // Sub-parser over text owned by another parser, used for parallel sections.
+    MQOParser(char const* text, size_t length);
+
     bool ParseScene(MQOScene& scene);
     bool ParseMaterials(std::vector<MQOMaterial>& materials);
     bool ParseObject(MQOObject& object);
     bool ParseVertices(std::vector<MQOVertex>& vertices);
-    bool ParseFaces(std::vector<MQOFace>& faces);
+    bool ParseFaces(std::vector<MQOFace>& faces, std::vector<MQOVertex> const& vertices);
     bool ParseVertexAttr(MQOObject& object);
     bool ParseMaterial(MQOMaterial& material);
     bool ParseVertex(MQOVertex& vertex);
-    bool ParseFace(MQOFace& face);
+    bool ParseFace(std::vector<MQOFace>& faces, std::vector<MQOVertex> const& vertices);
+
+    template<typename T, typename ParseLine>
+    bool ParseSectionParallel(std::vector<T>& elements, int32_t count, ParseLine const& parseLine);
 
     void SkipWhitespace();
     bool NextLine();
     Token NextToken();
     bool Expect(TokenType type, Token& token);
+    bool ExpectFloat(float& value);
+    bool ExpectInt(int32_t& value);
+    bool ConsumeKeyword(std::string_view keyword);
+    int32_t ParseSectionCount() const;
     void SkipToClosingBrace();
     void SkipToClosingParenthesis();
     bool SkipToMatchingBrace();
 
     bool SetError(std::string const& message);
 
-    std::ifstream m_file;
-    std::string m_currentLine;
+    static bool ToFloat(std::string_view text, float& value);
+    static bool ToInt(std::string_view text, int32_t& value);
+
+    MappedFile m_mappedFile;
+    bool m_good { false };
+    std::string_view m_text;
+    size_t m_offset = 0;
+    std::string_view m_currentLine;
     size_t m_position = 0;
     std::string m_errorMessage;
 };
@@ -0,0 +1,330 @@
+#include "MQOWriter.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace imp {
+constexpr size_t kWriteBufferSize = 1 << 20;
+// Large enough for any single number to_chars can produce for our types.
+constexpr size_t kMaxNumberLength = 32;
+
+MQOWriter::MQOWriter(std::filesystem::path const& outputPath)
+    : m_file(outputPath)
+    , m_buffer(kWriteBufferSize)
+{
+    // Do nothing.
+}
+
+MQOWriter::~MQOWriter()
+{
+    if (m_file.is_open()) {
+        Close();
+    }
+}
+
+bool MQOWriter::Close()
+{
+    Flush();
+    m_file.close();
+    return !m_file.fail();
+}
+
+void MQOWriter::WriteHeader()
+{
+    Append("Metasequoia Document\n");
+    Append("Format Text Ver 1.1\n");
+    Append("\n");
+}
+
+void MQOWriter::WriteScene(MQOScene const& scene)
+{
+    Append("Scene {\n");
+    Append("\tpos ");
+    AppendFloat(scene.posX);
+    Append(' ');
+    AppendFloat(scene.posY);
+    Append(' ');
+    AppendFloat(scene.posZ);
+    Append("\n\tlookat ");
+    AppendFloat(scene.lookatX);
+    Append(' ');
+    AppendFloat(scene.lookatY);
+    Append(' ');
+    AppendFloat(scene.lookatZ);
+    Append("\n\thead ");
+    AppendFloat(scene.head);
+    Append("\n\tpich ");
+    AppendFloat(scene.pitch);
+    Append("\n\tortho ");
+    AppendInt(scene.ortho);
+    Append("\n\tzoom2 ");
+    AppendFloat(scene.zoom2);
+    Append("\n\tamb ");
+    AppendFloat(scene.ambR);
+    Append(' ');
+    AppendFloat(scene.ambG);
+    Append(' ');
+    AppendFloat(scene.ambB);
+    Append("\n}\n");
+}
+
+void MQOWriter::WriteMaterials(std::vector<MQOMaterial> const& materials)
+{
+    if (materials.empty()) {
+        return;
+    }
+
+    Append("Material ");
+    AppendInt(static_cast<int64_t>(materials.size()));
+    Append(" {\n");
+
+    for (auto const& material : materials) {
+        Append("\t\"");
+        Append(material.name);
+        Append("\" shader(");
+        AppendInt(material.shader);
+        Append(") col(");
+        AppendFloat(material.r);
+        Append(' ');
+        AppendFloat(material.g);
+        Append(' ');
+        AppendFloat(material.b);
+        Append(' ');
+        AppendFloat(material.alpha);
+        Append(") dif(");
+        AppendFloat(material.diffuse);
+        Append(") amb(");
+        AppendFloat(material.ambient);
+        Append(") emi(");
+        AppendFloat(material.emission);
+        Append(") spc(");
+        AppendFloat(material.specular);
+        Append(") power(");
+        AppendFloat(material.power);
+        Append(")\n");
+    }
+
+    Append("}\n");
+}
+
+void MQOWriter::WriteObject(MQOObject const& object)
+{
+    BeginObject(object);
+
+    if (!object.vertices.empty()) {
+        BeginVertices(object.vertices.size());
+        for (auto const& vertex : object.vertices) {
+            WriteVertex(vertex.x, vertex.y, vertex.z);
+        }
+        EndVertices();
+
+        bool hasWeights = false;
+        for (auto const& vertex : object.vertices) {
+            if (vertex.weit.has_value()) {
+                hasWeights = true;
+                break;
+            }
+        }
+
+        if (hasWeights) {
+            BeginWeights();
+            for (size_t i = 0; i < object.vertices.size(); ++i) {
+                if (MQOVertex const& vertex = object.vertices[i]; vertex.weit.has_value()) {
+                    WriteWeight(i, vertex.weit.value());
+                }
+            }
+            EndWeights();
+        }
+    }
+
+    if (!object.faces.empty()) {
+        BeginFaces(object.faces.size());
+        for (auto const& face : object.faces) {
+            WriteFace(face.v1, face.v2, face.v3, face.materialIndex);
+        }
+        EndFaces();
+    }
+
+    EndObject();
+}
+
+void MQOWriter::WriteEof()
+{
+    Append("Eof\n");
+}
+
+void MQOWriter::BeginObject(MQOObject const& object)
+{
+    Append("Object \"");
+    Append(object.name);
+    Append("\" {\n\tdepth ");
+    AppendInt(object.depth);
+    Append("\n\tfolding ");
+    AppendInt(object.folding);
+    Append("\n\tscale ");
+    AppendFloat(object.scaleX);
+    Append(' ');
+    AppendFloat(object.scaleY);
+    Append(' ');
+    AppendFloat(object.scaleZ);
+    Append("\n\trotation ");
+    AppendFloat(object.rotationX);
+    Append(' ');
+    AppendFloat(object.rotationY);
+    Append(' ');
+    AppendFloat(object.rotationZ);
+    Append("\n\ttranslation ");
+    AppendFloat(object.translationX);
+    Append(' ');
+    AppendFloat(object.translationY);
+    Append(' ');
+    AppendFloat(object.translationZ);
+    Append("\n\tvisible ");
+    AppendInt(object.visible);
+    Append("\n\tlocking ");
+    AppendInt(object.locking);
+    Append("\n\tshading ");
+    AppendInt(object.shading);
+    Append("\n\tfacet ");
+    AppendFloat(object.facet);
+    Append("\n\tcolor ");
+    AppendFloat(object.colorR);
+    Append(' ');
+    AppendFloat(object.colorG);
+    Append(' ');
+    AppendFloat(object.colorB);
+    Append("\n\tcolor_type ");
+    AppendInt(object.colorType);
+    Append('\n');
+}
+
+void MQOWriter::EndObject()
+{
+    Append("}\n");
+}
+
+void MQOWriter::BeginVertices(size_t count)
+{
+    Append("\tvertex ");
+    AppendInt(static_cast<int64_t>(count));
+    Append(" {\n");
+}
+
+void MQOWriter::WriteVertex(float x, float y, float z)
+{
+    Reserve(3 * kMaxNumberLength + 8);
+    Append("\t\t");
+    AppendFloat(x);
+    Append(' ');
+    AppendFloat(y);
+    Append(' ');
+    AppendFloat(z);
+    Append('\n');
+}
+
+void MQOWriter::EndVertices()
+{
+    Append("\t}\n");
+}
+
+void MQOWriter::BeginWeights()
+{
+    Append("\tvertexattr {\n");
+    Append("\t\tweit {\n");
+}
+
+void MQOWriter::WriteWeight(size_t index, float weight)
+{
+    Append("\t\t\t");
+    AppendInt(static_cast<int64_t>(index));
+    Append(' ');
+    AppendFloat(weight);
+    Append('\n');
+}
+
+void MQOWriter::EndWeights()
+{
+    Append("\t\t}\n");
+    Append("\t}\n");
+}
+
+void MQOWriter::BeginFaces(size_t count)
+{
+    Append("\tface ");
+    AppendInt(static_cast<int64_t>(count));
+    Append(" {\n");
+}
+
+void MQOWriter::WriteFace(int32_t v1, int32_t v2, int32_t v3, int32_t materialIndex)
+{
+    Reserve(4 * kMaxNumberLength + 16);
+    Append("\t\t3 V(");
+    AppendInt(v3);
+    Append(' ');
+    AppendInt(v2);
+    Append(' ');
+    AppendInt(v1);
+    Append(") M(");
+    AppendInt(materialIndex);
+    Append(")\n");
+}
+
+void MQOWriter::EndFaces()
+{
+    Append("\t}\n");
+}
+
+void MQOWriter::Append(std::string_view text)
+{
+    if (m_used + text.size() > m_buffer.size()) {
+        Flush();
+        if (text.size() > m_buffer.size()) {
+            m_file.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return;
+        }
+    }
+    std::memcpy(m_buffer.data() + m_used, text.data(), text.size());
+    m_used += text.size();
+}
+
+void MQOWriter::Append(char c)
+{
+    if (m_used == m_buffer.size()) {
+        Flush();
+    }
+    m_buffer[m_used++] = c;
+}
+
+void MQOWriter::AppendInt(int64_t value)
+{
+    Reserve(kMaxNumberLength);
+    char* begin = m_buffer.data() + m_used;
+    auto [end, ec] = std::to_chars(begin, m_buffer.data() + m_buffer.size(), value);
+    m_used += end - begin;
+}
+
+void MQOWriter::AppendFloat(float value)
+{
+    // %g with six significant digits, which is what operator<< produced.
+    Reserve(kMaxNumberLength);
+    char* begin = m_buffer.data() + m_used;
+    auto [end, ec] = std::to_chars(begin, m_buffer.data() + m_buffer.size(), value, std::chars_format::general, 6);
+    m_used += end - begin;
+}
+
+void MQOWriter::Reserve(size_t size)
+{
+    if (m_used + size > m_buffer.size()) {
+        Flush();
+    }
+}
+
+void MQOWriter::Flush()
+{
+    if (m_used == 0) {
+        return;
+    }
+    m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_used));
+    m_used = 0;
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "MQOFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+namespace imp {
+// Streams an MQO document straight to disk. Numbers are formatted with
+// std::to_chars into a reusable buffer instead of going through the
+// locale-aware ostream operators, and sections can be emitted piecemeal
+// so callers can write geometry without first building an MQOFile.
+class MQOWriter {
+public:
+    explicit MQOWriter(std::filesystem::path const& outputPath);
+    ~MQOWriter();
+
+    MQOWriter(MQOWriter const&) = delete;
+    MQOWriter& operator=(MQOWriter const&) = delete;
+
+    bool Good() const
+    {
+        return m_file.good();
+    }
+
+    bool Close();
+
+    void WriteHeader();
+    void WriteScene(MQOScene const& scene);
+    void WriteMaterials(std::vector<MQOMaterial> const& materials);
+    void WriteObject(MQOObject const& object);
+    void WriteEof();
+
+    void BeginObject(MQOObject const& object);
+    void EndObject();
+
+    void BeginVertices(size_t count);
+    void WriteVertex(float x, float y, float z);
+    void EndVertices();
+
+    void BeginWeights();
+    void WriteWeight(size_t index, float weight);
+    void EndWeights();
+
+    void BeginFaces(size_t count);
+    void WriteFace(int32_t v1, int32_t v2, int32_t v3, int32_t materialIndex);
+    void EndFaces();
+
+private:
+    void Append(std::string_view text);
+    void Append(char c);
+    void AppendInt(int64_t value);
+    void AppendFloat(float value);
+    void Reserve(size_t size);
+    void Flush();
+
+    std::ofstream m_file;
+    std::vector<char> m_buffer;
+    size_t m_used { 0 };
+};
+}
@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+
+#ifdef IMP_PLATFORM_WINDOWS
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <fstream>
+#include <iterator>
+
+namespace imp {
+MappedFile::MappedFile(std::filesystem::path const& filePath, FileAccess access)
+{
+    Open(filePath, access);
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(std::filesystem::path const& filePath, FileAccess access)
+{
+    Close();
+    return access == FileAccess::Mapped ? Map(filePath) : Read(filePath);
+}
+
+void MappedFile::Close()
+{
+    if (m_data != m_buffer.data()) {
+        Unmap();
+    }
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_data = nullptr;
+    m_size = 0;
+    m_good = false;
+}
+
+bool MappedFile::Read(std::filesystem::path const& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    // The file may shrink or grow while it is read, so the view is whatever
+    // was actually read, not the size it had up front.
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (file.bad()) {
+        m_buffer.clear();
+        return false;
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_good = true;
+    return true;
+}
+
+#ifdef IMP_PLATFORM_WINDOWS
+bool MappedFile::Map(std::filesystem::path const& filePath)
+{
+    HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    m_fileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        Close();
+        return false;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    // Mapping an empty file is an error on Windows, but an empty view is not.
+    if (m_size == 0) {
+        m_good = true;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        Close();
+        return false;
+    }
+    m_mappingHandle = mapping;
+
+    m_data = static_cast<char const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        Close();
+        return false;
+    }
+    m_good = true;
+    return true;
+}
+
+void MappedFile::Unmap()
+{
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle != nullptr) {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle != nullptr) {
+        CloseHandle(m_fileHandle);
+    }
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+}
+#else
+bool MappedFile::Map(std::filesystem::path const& filePath)
+{
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    m_size = static_cast<size_t>(info.st_size);
+
+    if (m_size == 0) {
+        close(fd);
+        m_good = true;
+        return true;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        return false;
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    m_data = static_cast<char const*>(data);
+    m_good = true;
+    return true;
+}
+
+void MappedFile::Unmap()
+{
+    if (m_data != nullptr) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace imp {
+// A mapping saves copying the file, but touching it after another process
+// truncated the file raises SIGBUS. Files that may still be being written,
+// such as on hot reload, are read into memory instead.
+enum class FileAccess : uint8_t {
+    Mapped,
+    Buffered
+};
+
+// Read-only view of a whole file, memory mapped unless asked otherwise. The
+// view stays valid for the lifetime of the object.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(std::filesystem::path const& filePath, FileAccess access = FileAccess::Mapped);
+    ~MappedFile();
+
+    MAKE_NON_COPYABLE(MappedFile);
+
+    bool Open(std::filesystem::path const& filePath, FileAccess access = FileAccess::Mapped);
+    void Close();
+
+    bool Good() const
+    {
+        return m_good;
+    }
+
+    char const* GetData() const
+    {
+        return m_data;
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+    std::string_view GetView() const
+    {
+        return { m_data, m_size };
+    }
+
+private:
+    bool Map(std::filesystem::path const& filePath);
+    bool Read(std::filesystem::path const& filePath);
+    void Unmap();
+
+    char const* m_data { nullptr };
+    size_t m_size { 0 };
+    bool m_good { false };
+    std::string m_buffer;
+#ifdef IMP_PLATFORM_WINDOWS
+    void* m_fileHandle { nullptr };
+    void* m_mappingHandle { nullptr };
+#endif
+};
+}
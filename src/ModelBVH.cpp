@@ -0,0 +1,378 @@
+#include "ModelBVH.h"
+
+#include "ThreadBudget.h"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+
+namespace imp {
+constexpr uint32_t kBinCount = 16;
+constexpr uint32_t kMaxLeafSize = 4;
+// Subtrees at least this big are built on their own thread, down to a depth
+// that gives each core a few of them.
+constexpr uint32_t kParallelBuildThreshold = 16384;
+constexpr int kMaxParallelDepth = 4;
+// Traversal keeps at most one pending sibling per level plus the pair just
+// pushed, so a tree no deeper than this never overflows the stack. Nodes at
+// the limit become leaves however many faces they hold.
+constexpr size_t kTraversalStackSize = 64;
+constexpr int kMaxDepth = static_cast<int>(kTraversalStackSize) - 1;
+
+struct Bounds {
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { std::numeric_limits<float>::lowest() };
+
+    void Grow(glm::vec3 const& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Grow(Bounds const& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    float HalfArea() const
+    {
+        glm::vec3 extent = max - min;
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+};
+
+static glm::vec3 ToWorld(Vertex const& vertex)
+{
+    return { static_cast<float>(vertex.x), -static_cast<float>(vertex.y), static_cast<float>(vertex.z) };
+}
+
+// Slab test; returns the entry distance, or infinity on a miss.
+static float IntersectBounds(glm::vec3 const& min, glm::vec3 const& max, Ray const& ray, glm::vec3 const& inverseDirection, float maxDistance)
+{
+    glm::vec3 t0 = (min - ray.origin) * inverseDirection;
+    glm::vec3 t1 = (max - ray.origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+// Möller-Trumbore, accepting only triangles wound counter-clockwise as seen
+// along the ray, the ones that survive GL_BACK culling.
+static bool IntersectTriangle(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c, Ray const& ray, float& distance)
+{
+    constexpr float kEpsilon = 1e-8f;
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (determinant < kEpsilon) {
+        return false;
+    }
+    float inverseDeterminant = 1.0f / determinant;
+    glm::vec3 s = ray.origin - a;
+    float u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    float t = glm::dot(edge2, q) * inverseDeterminant;
+    if (t <= 0.0f || t >= distance) {
+        return false;
+    }
+    distance = t;
+    return true;
+}
+
+void ModelBVH::Build(ModelData const& model)
+{
+    Clear();
+
+    std::vector<Vertex> const& vertices = model.vertices;
+    m_triangles.reserve(model.faces.size());
+    m_cornerVertices.reserve(model.faces.size());
+    for (Face const& face : model.faces) {
+        if (face.v1 >= vertices.size() || face.v2 >= vertices.size() || face.v3 >= vertices.size()) {
+            // Keep the face numbering intact, degenerate triangles are never hit.
+            m_triangles.push_back({});
+            m_cornerVertices.push_back({ face.v3, face.v2, face.v1 });
+            continue;
+        }
+        // The renderer draws v3, v2, v1.
+        m_triangles.push_back({ ToWorld(vertices[face.v3]), ToWorld(vertices[face.v2]), ToWorld(vertices[face.v1]) });
+        m_cornerVertices.push_back({ face.v3, face.v2, face.v1 });
+    }
+    if (m_triangles.empty()) {
+        return;
+    }
+
+    uint32_t count = static_cast<uint32_t>(m_triangles.size());
+    m_primitives.resize(count);
+    m_faceIndices.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Triangle const& triangle = m_triangles[i];
+        Primitive& primitive = m_primitives[i];
+        primitive.min = glm::min(glm::min(triangle.a, triangle.b), triangle.c);
+        primitive.max = glm::max(glm::max(triangle.a, triangle.b), triangle.c);
+        primitive.centroid = (triangle.a + triangle.b + triangle.c) * (1.0f / 3.0f);
+        m_faceIndices[i] = i;
+    }
+
+    m_nodes.reserve(count * 2);
+    m_nodes.emplace_back();
+    BuildNode(m_nodes, 0, 0, count, 0);
+
+    // Put the triangles in leaf order so traversal reads them sequentially.
+    std::vector<Triangle> sorted(count);
+    std::vector<std::array<uint16_t, 3>> sortedCorners(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        sorted[i] = m_triangles[m_faceIndices[i]];
+        sortedCorners[i] = m_cornerVertices[m_faceIndices[i]];
+    }
+    m_triangles = std::move(sorted);
+    m_cornerVertices = std::move(sortedCorners);
+    m_primitives = {};
+}
+
+void ModelBVH::Clear()
+{
+    m_nodes.clear();
+    m_triangles.clear();
+    m_faceIndices.clear();
+    m_primitives.clear();
+    m_cornerVertices.clear();
+}
+
+void ModelBVH::BuildNode(std::vector<Node>& nodes, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth)
+{
+    Bounds bounds;
+    Bounds centroidBounds;
+    for (uint32_t i = first; i < first + count; ++i) {
+        Primitive const& primitive = m_primitives[m_faceIndices[i]];
+        bounds.min = glm::min(bounds.min, primitive.min);
+        bounds.max = glm::max(bounds.max, primitive.max);
+        centroidBounds.Grow(primitive.centroid);
+    }
+    nodes[nodeIndex].min = bounds.min;
+    nodes[nodeIndex].max = bounds.max;
+    nodes[nodeIndex].leftOrFirst = first;
+    nodes[nodeIndex].count = count;
+    if (count <= kMaxLeafSize || depth >= kMaxDepth) {
+        return;
+    }
+
+    // Bin the centroids along each axis and sweep the bins from both sides
+    // to find the cheapest split by surface area.
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    float bestCost = static_cast<float>(count) * bounds.HalfArea();
+    for (int axis = 0; axis < 3; ++axis) {
+        float axisMin = centroidBounds.min[axis];
+        float extent = centroidBounds.max[axis] - axisMin;
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float scale = kBinCount / extent;
+
+        Bounds binBounds[kBinCount];
+        uint32_t binCounts[kBinCount] {};
+        for (uint32_t i = first; i < first + count; ++i) {
+            Primitive const& primitive = m_primitives[m_faceIndices[i]];
+            uint32_t bin = std::min(kBinCount - 1, static_cast<uint32_t>((primitive.centroid[axis] - axisMin) * scale));
+            binBounds[bin].min = glm::min(binBounds[bin].min, primitive.min);
+            binBounds[bin].max = glm::max(binBounds[bin].max, primitive.max);
+            ++binCounts[bin];
+        }
+
+        float leftAreas[kBinCount - 1];
+        uint32_t leftCounts[kBinCount - 1];
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i < kBinCount - 1; ++i) {
+            left.Grow(binBounds[i]);
+            leftCount += binCounts[i];
+            leftAreas[i] = leftCount > 0 ? left.HalfArea() : 0.0f;
+            leftCounts[i] = leftCount;
+        }
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t i = kBinCount - 1; i > 0; --i) {
+            right.Grow(binBounds[i]);
+            rightCount += binCounts[i];
+            if (leftCounts[i - 1] == 0 || rightCount == 0) {
+                continue;
+            }
+            float cost = leftAreas[i - 1] * static_cast<float>(leftCounts[i - 1]) + right.HalfArea() * static_cast<float>(rightCount);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    uint32_t* begin = m_faceIndices.data() + first;
+    uint32_t* end = begin + count;
+    uint32_t* middle;
+    if (bestAxis >= 0) {
+        float axisMin = centroidBounds.min[bestAxis];
+        float scale = kBinCount / (centroidBounds.max[bestAxis] - axisMin);
+        middle = std::partition(begin, end, [&](uint32_t face) {
+            return std::min(kBinCount - 1, static_cast<uint32_t>((m_primitives[face].centroid[bestAxis] - axisMin) * scale)) < bestSplit;
+        });
+    } else if (count > kMaxLeafSize * 4) {
+        // Splitting looks no better than a leaf, usually because the
+        // centroids coincide. Halve big nodes anyway to bound leaf size.
+        middle = begin + count / 2;
+    } else {
+        return;
+    }
+
+    uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+    uint32_t rightCount = count - leftCount;
+    uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+    nodes[nodeIndex].leftOrFirst = leftIndex;
+    nodes[nodeIndex].count = 0;
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    // The extra thread comes out of the shared budget, so a rebuild while
+    // other work has the cores busy stays on this thread.
+    ThreadBudget budget(depth < kMaxParallelDepth && rightCount >= kParallelBuildThreshold ? 1 : 0);
+    if (budget.GetCount() == 0) {
+        BuildNode(nodes, leftIndex, first, leftCount, depth + 1);
+        BuildNode(nodes, leftIndex + 1, first + leftCount, rightCount, depth + 1);
+        return;
+    }
+
+    // The right subtree goes into its own node list on another thread. The
+    // two sides partition disjoint ranges of m_faceIndices, so they do not
+    // interfere, and the list is spliced in once both are done.
+    auto right = std::async(std::launch::async, [this, first, leftCount, rightCount, depth] {
+        std::vector<Node> subtree(1);
+        BuildNode(subtree, 0, first + leftCount, rightCount, depth + 1);
+        return subtree;
+    });
+    BuildNode(nodes, leftIndex, first, leftCount, depth + 1);
+
+    std::vector<Node> subtree = right.get();
+    // Node i > 0 of the subtree lands at base + i - 1; its root takes the
+    // slot reserved next to the left child.
+    uint32_t base = static_cast<uint32_t>(nodes.size());
+    for (Node& node : subtree) {
+        if (node.count == 0) {
+            node.leftOrFirst += base - 1;
+        }
+    }
+    nodes[leftIndex + 1] = subtree[0];
+    nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+}
+
+int ModelBVH::IntersectClosest(Ray const& ray, float& distance) const
+{
+    if (m_nodes.empty()) {
+        return -1;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+    distance = std::numeric_limits<float>::max();
+    int hitTriangle = -1;
+
+    uint32_t stack[kTraversalStackSize];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        Node const& node = m_nodes[stack[--stackSize]];
+        if (IntersectBounds(node.min, node.max, ray, inverseDirection, distance) == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                Triangle const& triangle = m_triangles[i];
+                if (IntersectTriangle(triangle.a, triangle.b, triangle.c, ray, distance)) {
+                    hitTriangle = static_cast<int>(i);
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so the far one is more often culled
+        // by the distance found there.
+        Node const& left = m_nodes[node.leftOrFirst];
+        Node const& right = m_nodes[node.leftOrFirst + 1];
+        float leftDistance = IntersectBounds(left.min, left.max, ray, inverseDirection, distance);
+        float rightDistance = IntersectBounds(right.min, right.max, ray, inverseDirection, distance);
+        uint32_t nearChild = node.leftOrFirst;
+        uint32_t farChild = node.leftOrFirst + 1;
+        if (rightDistance < leftDistance) {
+            std::swap(nearChild, farChild);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance != std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = farChild;
+        }
+        if (leftDistance != std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = nearChild;
+        }
+    }
+
+    return hitTriangle;
+}
+
+RayHit ModelBVH::Raycast(Ray const& ray) const
+{
+    RayHit hit;
+    float distance;
+    int index = IntersectClosest(ray, distance);
+    if (index >= 0) {
+        hit.face = static_cast<int>(m_faceIndices[index]);
+        hit.distance = distance;
+        hit.position = ray.origin + ray.direction * distance;
+    }
+    return hit;
+}
+
+int ModelBVH::RaycastVertex(Ray const& ray) const
+{
+    float distance;
+    int index = IntersectClosest(ray, distance);
+    if (index < 0) {
+        return -1;
+    }
+
+    glm::vec3 position = ray.origin + ray.direction * distance;
+    Triangle const& triangle = m_triangles[index];
+    glm::vec3 const corners[3] = { triangle.a, triangle.b, triangle.c };
+
+    int nearest = 0;
+    float nearestDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; ++i) {
+        glm::vec3 offset = corners[i] - position;
+        float distance = glm::dot(offset, offset);
+        if (distance < nearestDistance) {
+            nearestDistance = distance;
+            nearest = i;
+        }
+    }
+    return m_cornerVertices[index][nearest];
+}
+
+Ray ModelBVH::RayFromViewport(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
+{
+    float ndcX = (static_cast<float>(x) + 0.5f) / static_cast<float>(viewportWidth) * 2.0f - 1.0f;
+    float ndcY = 1.0f - (static_cast<float>(y) + 0.5f) / static_cast<float>(viewportHeight) * 2.0f;
+
+    glm::mat4 inverse = glm::inverse(projectionMatrix * viewMatrix);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 target = glm::vec3(farPoint) / farPoint.w;
+    return { origin, glm::normalize(target - origin) };
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Model.h"
+
+#include <array>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace imp {
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct RayHit {
+    int face { -1 };
+    float distance { 0.0f };
+    glm::vec3 position { 0.0f };
+};
+
+// Bounding volume hierarchy over a model's faces, in the renderer's world
+// space (model y flipped). Built top-down with binned SAH splits, with the
+// large subtrees built on worker threads. Needs no GL context, so tools can
+// use it as well as the viewer.
+class ModelBVH {
+public:
+    void Build(ModelData const& model);
+    void Clear();
+
+    bool IsEmpty() const
+    {
+        return m_nodes.empty();
+    }
+
+    // The closest face the ray hits from the front. Back faces are skipped
+    // because the renderer culls them, so this is the face the user sees.
+    RayHit Raycast(Ray const& ray) const;
+    // The corner of the face under the ray that is closest to the hit point.
+    int RaycastVertex(Ray const& ray) const;
+
+    // The ray through the center of a viewport pixel, with y pointing down
+    // as in window coordinates.
+    static Ray RayFromViewport(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
+
+private:
+    // Interior nodes have count == 0 and their children at leftOrFirst and
+    // leftOrFirst + 1. Leaves cover count triangles starting at leftOrFirst.
+    struct Node {
+        glm::vec3 min;
+        uint32_t leftOrFirst;
+        glm::vec3 max;
+        uint32_t count;
+    };
+
+    // Corners in draw order, the order the GPU sees them in.
+    struct Triangle {
+        glm::vec3 a;
+        glm::vec3 b;
+        glm::vec3 c;
+    };
+
+    // Per-face build input, dropped once the tree is built.
+    struct Primitive {
+        glm::vec3 min;
+        glm::vec3 max;
+        glm::vec3 centroid;
+    };
+
+    void BuildNode(std::vector<Node>& nodes, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth);
+    // Index of the closest front-facing triangle hit, or -1.
+    int IntersectClosest(Ray const& ray, float& distance) const;
+
+    std::vector<Node> m_nodes;
+    // Both in leaf order: triangle i belongs to face m_faceIndices[i].
+    std::vector<Triangle> m_triangles;
+    std::vector<uint32_t> m_faceIndices;
+    std::vector<Primitive> m_primitives;
+    // The model vertex behind each triangle corner, in the same order.
+    std::vector<std::array<uint16_t, 3>> m_cornerVertices;
+};
+}
@@ -1,17 +1,36 @@
 #include "ModelExporter.h"
 
 #include "Dialogs.h"
+#include "MQOWriter.h"
 #include "Packet.h"
 #include "RunetekColor.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <random>
 #include <unordered_map>
 
+#include <nlohmann/json.hpp>
+
 namespace imp {
 static uint32_t PackFaceColorAndAlpha(Face const& face)
 {
-    return face.color | (face.trans.value_or(0) & 0xff) << 8;
+    return face.color | (face.trans.value_or(0) & 0xff) << 16;
+}
+
+// Progress is only published every this many elements to keep the atomic
+// stores out of the hot loops.
+constexpr size_t kProgressInterval = 4096;
+
+static void ReportProgress(std::atomic<float>* progress, float value)
+{
+    if (progress != nullptr) {
+        progress->store(value, std::memory_order_relaxed);
+    }
 }
 
 static bool WriteBinary(std::filesystem::path const& path, Packet const& packet)
@@ -24,12 +43,79 @@ static bool WriteBinary(std::filesystem::path const& path, Packet const& packet)
     return true;
 }
 
-bool ModelExporter::ExportMQO(ModelData const& model, std::filesystem::path const& outputPath)
+// Every MQO object we emit shares the model geometry and only differs in the
+// per-face material index, so the geometry is streamed straight from the model.
+template<typename MaterialFn>
+static void WriteMQOObject(MQOWriter& writer, char const* name, ModelData const& model, MaterialFn const& materialOf, std::atomic<float>* progress, float progressStart, float progressEnd)
+{
+    MQOObject object;
+    object.name = name;
+    writer.BeginObject(object);
+
+    writer.BeginVertices(model.vertices.size());
+    bool hasWeights = false;
+    for (auto const& vertex : model.vertices) {
+        writer.WriteVertex(vertex.x, static_cast<float>(-vertex.y), static_cast<float>(-vertex.z));
+        hasWeights |= vertex.label.has_value();
+    }
+    writer.EndVertices();
+
+    if (hasWeights) {
+        writer.BeginWeights();
+        for (size_t i = 0; i < model.vertices.size(); ++i) {
+            if (Vertex const& vertex = model.vertices[i]; vertex.label.has_value()) {
+                writer.WriteWeight(i, static_cast<float>(vertex.label.value()) / 1000.0f);
+            }
+        }
+        writer.EndWeights();
+    }
+
+    writer.BeginFaces(model.faces.size());
+    float progressStep = (progressEnd - progressStart) / static_cast<float>(model.faces.size());
+    for (size_t i = 0; i < model.faces.size(); ++i) {
+        Face const& face = model.faces[i];
+        writer.WriteFace(face.v1, face.v2, face.v3, materialOf(i, face));
+        if (i % kProgressInterval == 0) {
+            ReportProgress(progress, progressStart + progressStep * static_cast<float>(i));
+        }
+    }
+    writer.EndFaces();
+
+    writer.EndObject();
+    ReportProgress(progress, progressEnd);
+}
+
+bool ModelExporter::Export(ModelData const& model, std::filesystem::path const& outputPath, ExportFormat format, std::atomic<float>* progress)
+{
+    switch (format) {
+    case ExportFormat::MQO:
+        return ExportMQO(model, outputPath, progress);
+    case ExportFormat::DAT:
+        return ExportV1(model, outputPath, progress);
+    case ExportFormat::GLB:
+        return ExportGLB(model, outputPath, progress);
+    }
+    return false;
+}
+
+char const* ModelExporter::GetExtension(ExportFormat format)
+{
+    switch (format) {
+    case ExportFormat::MQO:
+        return ".mqo";
+    case ExportFormat::DAT:
+        return ".dat";
+    case ExportFormat::GLB:
+        return ".glb";
+    }
+    return "";
+}
+
+bool ModelExporter::ExportMQO(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress)
 {
     if (model.vertices.empty() || model.faces.empty()) {
         return false;
     }
-    MQOFile mqoFile;
 
     bool hasFaceLabels = false;
     bool hasFacePriority = false;
@@ -46,109 +132,100 @@ bool ModelExporter::ExportMQO(ModelData const& model, std::filesystem::path cons
         }
     }
 
+    std::vector<MQOMaterial> materials;
     if (hasFaceLabels || hasFacePriority) {
-        AddMQOHelperMaterials(mqoFile, 800);
+        AddMQOHelperMaterials(materials, 800);
     }
 
-    std::unordered_map<uint32_t, uint32_t> materialLookup;
-
-    MQOObject& geom = mqoFile.AddObject("GEOM");
-    AddMQOGeometry(geom, model);
-    AddMQOColors(materialLookup, mqoFile, geom, model);
+    std::vector<int32_t> faceMaterials;
+    AddMQOColors(materials, faceMaterials, model);
 
+    MQOWriter writer(outputPath);
+    if (!writer.Good()) {
+        return false;
+    }
+    writer.WriteHeader();
+    writer.WriteScene(MQOScene {});
+    writer.WriteMaterials(materials);
+
+    float objectCount = 1.0f + (hasFaceLabels ? 1.0f : 0.0f) + (hasFacePriority ? 1.0f : 0.0f);
+    float objectSpan = 1.0f / objectCount;
+    float objectStart = 0.0f;
+
+    WriteMQOObject(
+        writer, "GEOM", model, [&](size_t index, Face const&) {
+            return faceMaterials[index];
+        },
+        progress, objectStart, objectStart + objectSpan);
+    objectStart += objectSpan;
     if (hasFaceLabels) {
-        MQOObject& tskin = mqoFile.AddObject("TSKIN");
-        AddMQOGeometry(tskin, model);
-        for (size_t i = 0; i < model.faces.size(); ++i) {
-            if (Face const& face = model.faces[i]; face.label.has_value()) {
-                tskin.faces[i].materialIndex = face.label.value();
-            }
-        }
+        WriteMQOObject(
+            writer, "TSKIN", model, [](size_t, Face const& face) {
+                return static_cast<int32_t>(face.label.value_or(0));
+            },
+            progress, objectStart, objectStart + objectSpan);
+        objectStart += objectSpan;
     }
     if (hasFacePriority) {
-        MQOObject& pri = mqoFile.AddObject("PRI");
-        AddMQOGeometry(pri, model);
-        for (size_t i = 0; i < model.faces.size(); ++i) {
-            if (Face const& face = model.faces[i]; face.priority.has_value()) {
-                pri.faces[i].materialIndex = face.priority.value();
-            }
-        }
+        WriteMQOObject(
+            writer, "PRI", model, [](size_t, Face const& face) {
+                return static_cast<int32_t>(face.priority.value_or(0));
+            },
+            progress, objectStart, objectStart + objectSpan);
     }
-    return mqoFile.Write(outputPath);
-}
 
-void ModelExporter::AddMQOGeometry(MQOObject& mqoObject, ModelData const& model)
-{
-    mqoObject.vertices.reserve(model.vertices.size());
-    for (auto const& vertex : model.vertices) {
-        MQOVertex& mqoVertex = mqoObject.vertices.emplace_back();
-        mqoVertex.x = vertex.x;
-        mqoVertex.y = static_cast<float>(-vertex.y);
-        mqoVertex.z = static_cast<float>(-vertex.z);
-        if (vertex.label.has_value()) {
-            mqoVertex.weit = static_cast<float>(vertex.label.value()) / 1000.0f;
-        }
-    }
-
-    mqoObject.faces.reserve(model.faces.size());
-    for (auto const& face : model.faces) {
-        MQOFace& mqoFace = mqoObject.faces.emplace_back();
-        mqoFace.v1 = face.v1;
-        mqoFace.v2 = face.v2;
-        mqoFace.v3 = face.v3;
-    }
+    writer.WriteEof();
+    return writer.Close();
 }
 
-void ModelExporter::AddMQOColors(std::unordered_map<uint32_t, uint32_t>& materials, MQOFile& mqoFile, MQOObject& mqoObject, ModelData const& model)
+void ModelExporter::AddMQOColors(std::vector<MQOMaterial>& materials, std::vector<int32_t>& faceMaterials, ModelData const& model)
 {
+    std::unordered_map<uint32_t, int32_t> materialLookup;
+    faceMaterials.resize(model.faces.size());
     for (size_t i = 0; i < model.faces.size(); ++i) {
         Face const& face = model.faces[i];
         uint32_t packed = PackFaceColorAndAlpha(face);
-        uint16_t color = face.color;
-        uint8_t trans = face.trans.value_or(0) & 0xff;
 
-        auto const& findIt = materials.find(color);
-        uint32_t index;
-        if (findIt == materials.end()) {
+        auto const& findIt = materialLookup.find(packed);
+        int32_t index;
+        if (findIt == materialLookup.end()) {
+            uint16_t color = face.color;
+            uint8_t trans = face.trans.value_or(0) & 0xff;
             float alpha = (255.0f - static_cast<float>(trans)) / 255.0f;
 
             uint32_t rgb = math::RunetekColor::HSLToRGB(color);
-            float r = static_cast<float>(rgb >> 16 & 0xFF) / 255.0f;
-            float g = static_cast<float>(rgb >> 8 & 0xFF) / 255.0f;
-            float b = static_cast<float>(rgb & 0xFF) / 255.0f;
 
-            MQOMaterial material;
+            MQOMaterial& material = materials.emplace_back();
             material.name = "mat" + std::to_string(color);
-            material.r = r;
-            material.g = g;
-            material.b = b;
+            material.r = static_cast<float>(rgb >> 16 & 0xFF) / 255.0f;
+            material.g = static_cast<float>(rgb >> 8 & 0xFF) / 255.0f;
+            material.b = static_cast<float>(rgb & 0xFF) / 255.0f;
             material.alpha = alpha;
-            index = mqoFile.AddMaterial(material);
-            materials[packed] = index;
+            index = static_cast<int32_t>(materials.size() - 1);
+            materialLookup[packed] = index;
         } else {
             index = findIt->second;
         }
 
-        mqoObject.faces[i].materialIndex = static_cast<int>(index);
+        faceMaterials[i] = index;
     }
 }
 
-void ModelExporter::AddMQOHelperMaterials(MQOFile& mqoFile, int count)
+void ModelExporter::AddMQOHelperMaterials(std::vector<MQOMaterial>& materials, int count)
 {
+    materials.reserve(materials.size() + count);
     for (int i = 0; i < count; ++i) {
         uint32_t rgb = math::RunetekColor::HelperToRGB(static_cast<uint16_t>(i));
 
-        MQOMaterial material;
+        MQOMaterial& material = materials.emplace_back();
         material.name = std::to_string(i);
         material.r = static_cast<float>(rgb >> 16 & 0xff) / 255.0f;
         material.g = static_cast<float>(rgb >> 8 & 0xff) / 255.0f;
         material.b = static_cast<float>(rgb & 0xff) / 255.0f;
-
-        mqoFile.AddMaterial(material);
     }
 }
 
-bool ModelExporter::ExportV1(ModelData const& model, std::filesystem::path const& outputPath)
+bool ModelExporter::ExportV1(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress)
 {
     uint32_t vertexCount = static_cast<uint32_t>(model.vertices.size());
     uint32_t faceCount = static_cast<uint32_t>(model.faces.size());
@@ -236,6 +313,7 @@ bool ModelExporter::ExportV1(ModelData const& model, std::filesystem::path const
             verticesLabelBlock.p1(vertex.label.value_or(255));
         }
     }
+    ReportProgress(progress, 0.3f);
     for (Face const& face : model.faces) {
         int16_t materialId = face.material.value_or(-1);
         if (materialId != -1) {
@@ -264,6 +342,8 @@ bool ModelExporter::ExportV1(ModelData const& model, std::filesystem::path const
             facesLabelBlock.p1(face.label.value_or(255));
         }
     }
+    ReportProgress(progress, 0.6f);
+
     int16_t a = -65000;
     int16_t b = -65000;
     int16_t c = -65000;
@@ -355,6 +435,211 @@ bool ModelExporter::ExportV1(ModelData const& model, std::filesystem::path const
     combined.p2(verticesZBlock.GetSize());
     combined.p2(facesIndexBlock.GetSize());
 
+    ReportProgress(progress, 0.9f);
     return WriteBinary(outputPath, combined);
 }
+// GLB container constants, see the glTF 2.0 specification section 4.4.
+constexpr uint32_t kGlbMagic = 0x46546C67;
+constexpr uint32_t kGlbVersion = 2;
+constexpr uint32_t kGlbChunkJson = 0x4E4F534A;
+constexpr uint32_t kGlbChunkBin = 0x004E4942;
+
+constexpr int kGltfFloat = 5126;
+constexpr int kGltfUnsignedByte = 5121;
+constexpr int kGltfUnsignedShort = 5123;
+constexpr int kGltfArrayBuffer = 34962;
+
+template<typename T>
+static void StoreLE(uint8_t* dst, T value)
+{
+    ReorderToLE(value);
+    std::memcpy(dst, &value, sizeof(T));
+}
+
+// glTF vertex colors are linear, while the palette holds sRGB display
+// values. The linear values are kept at 16 bits, since 8 would band the
+// dark end of the palette.
+static std::array<uint16_t, 256> const& SRGBToLinearTable()
+{
+    static std::array<uint16_t, 256> const table = [] {
+        std::array<uint16_t, 256> values {};
+        for (size_t i = 0; i < values.size(); ++i) {
+            double srgb = static_cast<double>(i) / 255.0;
+            double linear = srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+            values[i] = static_cast<uint16_t>(std::lround(linear * 65535.0));
+        }
+        return values;
+    }();
+    return table;
+}
+
+bool ModelExporter::ExportGLB(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress)
+{
+    if (model.vertices.empty() || model.faces.empty()) {
+        return false;
+    }
+
+    bool hasFaceLabels = false;
+    bool hasFacePriority = false;
+    bool hasTransparency = false;
+    for (auto const& face : model.faces) {
+        hasFaceLabels |= face.label.has_value();
+        hasFacePriority |= face.priority.has_value();
+        hasTransparency |= face.trans.value_or(0) != 0;
+    }
+    bool hasFaceAttributes = hasFaceLabels || hasFacePriority;
+
+    // Colors are per face, so every face gets its own three vertices and the
+    // primitive is drawn without an index buffer.
+    size_t const vertexCount = model.faces.size() * 3;
+    size_t const positionsSize = vertexCount * 3 * sizeof(float);
+    size_t const colorsSize = vertexCount * 4 * sizeof(uint16_t);
+    // Label and priority each take a 4-byte slot of an 8-byte element,
+    // since glTF wants every vertex attribute offset 4-byte aligned.
+    size_t const attributesStride = 8;
+    size_t const attributesSize = hasFaceAttributes ? vertexCount * attributesStride : 0;
+
+    size_t const positionsOffset = 0;
+    size_t const colorsOffset = positionsOffset + positionsSize;
+    size_t const attributesOffset = colorsOffset + colorsSize;
+    size_t const binarySize = attributesOffset + attributesSize;
+
+    std::vector<uint8_t> binary(binarySize);
+    uint8_t* positions = binary.data() + positionsOffset;
+    uint8_t* colors = binary.data() + colorsOffset;
+    uint8_t* attributes = binary.data() + attributesOffset;
+
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float minZ = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxY = std::numeric_limits<float>::lowest();
+    float maxZ = std::numeric_limits<float>::lowest();
+
+    std::array<uint16_t, 256> const& toLinear = SRGBToLinearTable();
+    float progressStep = 0.9f / static_cast<float>(model.faces.size());
+    for (size_t faceIndex = 0; faceIndex < model.faces.size(); ++faceIndex) {
+        Face const& face = model.faces[faceIndex];
+        if (faceIndex % kProgressInterval == 0) {
+            ReportProgress(progress, progressStep * static_cast<float>(faceIndex));
+        }
+
+        uint32_t rgb = math::RunetekColor::HSLToRGB(face.color);
+        uint16_t red = toLinear[rgb >> 16 & 0xff];
+        uint16_t green = toLinear[rgb >> 8 & 0xff];
+        uint16_t blue = toLinear[rgb & 0xff];
+        // Alpha is coverage, not a color, so it is only widened.
+        uint16_t alpha = static_cast<uint16_t>((255 - (face.trans.value_or(0) & 0xff)) * 257);
+        uint8_t label = face.label.value_or(0);
+        uint8_t priority = static_cast<uint8_t>(face.priority.value_or(0));
+
+        for (uint16_t index : { face.v1, face.v2, face.v3 }) {
+            Vertex const* vertex = model.GetVertex(index);
+            if (vertex == nullptr) {
+                return false;
+            }
+            float x = vertex->x;
+            float y = static_cast<float>(-vertex->y);
+            float z = static_cast<float>(-vertex->z);
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            minZ = std::min(minZ, z);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+            maxZ = std::max(maxZ, z);
+
+            StoreLE(positions, x);
+            StoreLE(positions + 4, y);
+            StoreLE(positions + 8, z);
+            positions += 12;
+
+            StoreLE(colors, red);
+            StoreLE(colors + 2, green);
+            StoreLE(colors + 4, blue);
+            StoreLE(colors + 6, alpha);
+            colors += 8;
+
+            if (hasFaceAttributes) {
+                attributes[0] = label;
+                attributes[4] = priority;
+                attributes += attributesStride;
+            }
+        }
+    }
+
+    nlohmann::json attributesJson;
+    nlohmann::json bufferViews = nlohmann::json::array();
+    nlohmann::json accessors = nlohmann::json::array();
+
+    bufferViews.push_back({ { "buffer", 0 }, { "byteOffset", positionsOffset }, { "byteLength", positionsSize }, { "target", kGltfArrayBuffer } });
+    accessors.push_back({ { "bufferView", 0 }, { "componentType", kGltfFloat }, { "count", vertexCount }, { "type", "VEC3" }, { "min", { minX, minY, minZ } }, { "max", { maxX, maxY, maxZ } } });
+    attributesJson["POSITION"] = 0;
+
+    bufferViews.push_back({ { "buffer", 0 }, { "byteOffset", colorsOffset }, { "byteLength", colorsSize }, { "target", kGltfArrayBuffer } });
+    accessors.push_back({ { "bufferView", 1 }, { "componentType", kGltfUnsignedShort }, { "normalized", true }, { "count", vertexCount }, { "type", "VEC4" } });
+    attributesJson["COLOR_0"] = 1;
+
+    if (hasFaceAttributes) {
+        bufferViews.push_back({ { "buffer", 0 }, { "byteOffset", attributesOffset }, { "byteLength", attributesSize }, { "byteStride", attributesStride }, { "target", kGltfArrayBuffer } });
+        if (hasFaceLabels) {
+            attributesJson["_LABEL"] = accessors.size();
+            accessors.push_back({ { "bufferView", 2 }, { "byteOffset", 0 }, { "componentType", kGltfUnsignedByte }, { "count", vertexCount }, { "type", "SCALAR" } });
+        }
+        if (hasFacePriority) {
+            attributesJson["_PRIORITY"] = accessors.size();
+            accessors.push_back({ { "bufferView", 2 }, { "byteOffset", 4 }, { "componentType", kGltfUnsignedByte }, { "count", vertexCount }, { "type", "SCALAR" } });
+        }
+    }
+
+    nlohmann::json material = {
+        { "name", "vertexColor" },
+        { "pbrMetallicRoughness", { { "metallicFactor", 0.0 }, { "roughnessFactor", 1.0 } } },
+    };
+    if (hasTransparency) {
+        material["alphaMode"] = "BLEND";
+    }
+
+    nlohmann::json document = {
+        { "asset", { { "version", "2.0" }, { "generator", "modelviewer" } } },
+        { "scene", 0 },
+        { "scenes", { { { "nodes", { 0 } } } } },
+        { "nodes", { { { "mesh", 0 }, { "name", outputPath.stem().string() } } } },
+        { "meshes", { { { "primitives", { { { "attributes", attributesJson }, { "material", 0 } } } } } } },
+        { "materials", { material } },
+        { "buffers", { { { "byteLength", binarySize } } } },
+        { "bufferViews", bufferViews },
+        { "accessors", accessors },
+    };
+
+    std::string json = document.dump();
+    json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+    ReportProgress(progress, 0.9f);
+
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint8_t word[sizeof(uint32_t)];
+    auto writeU32 = [&](uint32_t value) {
+        StoreLE(word, value);
+        file.write(reinterpret_cast<char const*>(word), sizeof(word));
+    };
+
+    writeU32(kGlbMagic);
+    writeU32(kGlbVersion);
+    writeU32(static_cast<uint32_t>(12 + 8 + json.size() + 8 + binarySize));
+
+    writeU32(static_cast<uint32_t>(json.size()));
+    writeU32(kGlbChunkJson);
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+
+    writeU32(static_cast<uint32_t>(binarySize));
+    writeU32(kGlbChunkBin);
+    file.write(reinterpret_cast<char const*>(binary.data()), static_cast<std::streamsize>(binarySize));
+
+    file.close();
+    return !file.fail();
+}
 }
@@ -2,18 +2,30 @@
 
 #include "MQOFile.h"
 #include "Model.h"
+#include <atomic>
 #include <filesystem>
-#include <unordered_map>
+#include <vector>
 
 namespace imp {
+enum class ExportFormat {
+    MQO,
+    DAT,
+    GLB
+};
+
 class ModelExporter {
 public:
-    static bool ExportMQO(ModelData const& model, std::filesystem::path const& outputPath);
-    static bool ExportV1(ModelData const& model, std::filesystem::path const& outputPath);
+    // When progress is given it is updated from 0 to 1 as the export advances,
+    // so another thread can poll it while the export runs.
+    static bool Export(ModelData const& model, std::filesystem::path const& outputPath, ExportFormat format, std::atomic<float>* progress = nullptr);
+    static char const* GetExtension(ExportFormat format);
+
+    static bool ExportMQO(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress = nullptr);
+    static bool ExportV1(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress = nullptr);
+    static bool ExportGLB(ModelData const& model, std::filesystem::path const& outputPath, std::atomic<float>* progress = nullptr);
 
 private:
-    static void AddMQOGeometry(MQOObject& mqoObject, ModelData const& model);
-    static void AddMQOColors(std::unordered_map<uint32_t, uint32_t>& materials, MQOFile& mqoFile, MQOObject& mqoObject, ModelData const& model);
-    static void AddMQOHelperMaterials(MQOFile& mqoFile, int count);
+    static void AddMQOColors(std::vector<MQOMaterial>& materials, std::vector<int32_t>& faceMaterials, ModelData const& model);
+    static void AddMQOHelperMaterials(std::vector<MQOMaterial>& materials, int count);
 };
 }
@@ -753,9 +753,21 @@ bool ModelLoader::LoadV3(ModelData& model, Packet& packet)
 }
 
 bool ModelLoader::LoadFromFile(ModelData& model, std::filesystem::path const& filePath)
+{
+    std::string errorMessage;
+    if (!LoadFromFile(model, filePath, errorMessage)) {
+        if (!errorMessage.empty()) {
+            UI::ShowErrorAlert("Error", errorMessage);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool ModelLoader::LoadFromFile(ModelData& model, std::filesystem::path const& filePath, std::string& errorMessage, FileAccess access)
 {
     if (!std::filesystem::exists(filePath)) {
-        UI::ShowAlert("Error", "File does not exist: " + filePath.string(), AlertType::Error);
+        errorMessage = "File does not exist: " + filePath.string();
         return false;
     }
 
@@ -765,11 +777,11 @@ bool ModelLoader::LoadFromFile(ModelData& model, std::filesystem::path const& fi
     }
 
     if (extension == ".mqo") {
-        return LoadMQO(model, filePath);
+        return LoadMQO(model, filePath, errorMessage, access);
     } else {
         std::ifstream file(filePath, std::ios::binary);
         if (!file.is_open()) {
-            UI::ShowErrorAlert("Error", "Failed to open file: " + filePath.string());
+            errorMessage = "Failed to open file: " + filePath.string();
             return false;
         }
 
@@ -779,38 +791,42 @@ bool ModelLoader::LoadFromFile(ModelData& model, std::filesystem::path const& fi
 
         Packet packet(fileSize);
         file.read(reinterpret_cast<char*>(packet.GetData()), fileSize);
+        if (static_cast<size_t>(file.gcount()) != fileSize) {
+            errorMessage = "File changed while it was read: " + filePath.string();
+            return false;
+        }
         file.close();
 
         return LoadAny(model, packet);
     }
 }
 
-bool ModelLoader::LoadMQO(ModelData& model, std::filesystem::path const& filePath)
+bool ModelLoader::LoadMQO(ModelData& model, std::filesystem::path const& filePath, std::string& errorMessage, FileAccess access)
 {
     if (!std::filesystem::exists(filePath)) {
-        UI::ShowErrorAlert("Error", "MQO file does not exist: " + filePath.string());
+        errorMessage = "MQO file does not exist: " + filePath.string();
         return false;
     }
 
-    MQOParser parser(filePath);
+    MQOParser parser(filePath, access);
     if (!parser.Good()) {
-        UI::ShowErrorAlert("Error", "Failed to open MQO file: " + filePath.string());
+        errorMessage = "Failed to open MQO file: " + filePath.string();
         return false;
     }
 
     MQOFile mqoFile;
     if (!parser.Parse(mqoFile)) {
-        UI::ShowErrorAlert("Error", parser.GetErrorMessage() + ": " + filePath.string());
+        errorMessage = parser.GetErrorMessage() + ": " + filePath.string();
         return false;
     }
 
-    return ConvertFromMQO(model, mqoFile);
+    return ConvertFromMQO(model, mqoFile, errorMessage);
 }
 
-bool ModelLoader::ConvertFromMQO(ModelData& model, MQOFile const& mqoFile)
+bool ModelLoader::ConvertFromMQO(ModelData& model, MQOFile const& mqoFile, std::string& errorMessage)
 {
     if (mqoFile.m_objects.empty()) {
-        UI::ShowErrorAlert("Invalid MQO", "No valid objects found in MQO file.");
+        errorMessage = "No valid objects found in MQO file.";
         return false;
     }
 
@@ -827,7 +843,7 @@ bool ModelLoader::ConvertFromMQO(ModelData& model, MQOFile const& mqoFile)
         }
     }
     if (mainObject == nullptr) {
-        UI::ShowErrorAlert("Invalid MQO", "No valid GEOM object found in MQO file.");
+        errorMessage = "No valid GEOM object found in MQO file.";
         return false;
     }
 
@@ -871,6 +887,23 @@ bool ModelLoader::ConvertFromMQO(ModelData& model, MQOFile const& mqoFile)
         }
     }
 
+    // Many faces share a material, so every material color is converted once
+    // up front instead of once per face.
+    std::vector<uint32_t> materialColors;
+    std::vector<uint8_t> materialTrans;
+    materialColors.reserve(mqoFile.m_materials.size());
+    materialTrans.reserve(mqoFile.m_materials.size());
+    for (MQOMaterial const& material : mqoFile.m_materials) {
+        uint8_t r = static_cast<uint8_t>(material.r * 255.0f + 0.5f);
+        uint8_t g = static_cast<uint8_t>(material.g * 255.0f + 0.5f);
+        uint8_t b = static_cast<uint8_t>(material.b * 255.0f + 0.5f);
+        uint8_t alpha = static_cast<uint8_t>(material.alpha * 255.0f + 0.5f);
+        materialColors.push_back(r << 16 | g << 8 | b);
+        materialTrans.push_back(static_cast<uint8_t>(255 - alpha));
+    }
+    std::vector<uint16_t> materialHSL(materialColors.size());
+    math::RunetekColor::RGBToHSL(materialColors, materialHSL);
+
     model.faces.reserve(mainObject->faces.size());
     for (MQOFace const& mqoFace : mainObject->faces) {
         Face face;
@@ -878,15 +911,9 @@ bool ModelLoader::ConvertFromMQO(ModelData& model, MQOFile const& mqoFile)
         face.v2 = mqoFace.v2;
         face.v3 = mqoFace.v3;
 
-        if (MQOMaterial const* material = mqoFile.GetMaterial(mqoFace.materialIndex)) {
-            uint8_t r = static_cast<uint8_t>(material->r * 255.0f + 0.5f);
-            uint8_t g = static_cast<uint8_t>(material->g * 255.0f + 0.5f);
-            uint8_t b = static_cast<uint8_t>(material->b * 255.0f + 0.5f);
-            uint8_t alpha = static_cast<uint8_t>(material->alpha * 255.0f + 0.5f);
-            uint8_t trans = static_cast<uint8_t>(255 - alpha);
-
-            face.color = math::RunetekColor::RGBToHSL(r << 16 | g << 8 | b);
-            if (trans != 0) {
+        if (mqoFile.GetMaterial(mqoFace.materialIndex)) {
+            face.color = materialHSL[mqoFace.materialIndex];
+            if (uint8_t trans = materialTrans[mqoFace.materialIndex]; trans != 0) {
                 face.trans = trans;
             }
         }
@@ -1,22 +1,27 @@
 #pragma once
 
 #include "MQOFile.h"
+#include "MappedFile.h"
 #include "Model.h"
 #include "Packet.h"
 #include <filesystem>
+#include <string>
 
 namespace imp {
 class ModelLoader {
 public:
     static bool LoadFromFile(ModelData& model, std::filesystem::path const& filePath);
+    // Same as above but reports failures through errorMessage instead of the UI,
+    // so it can be used without a window (batch export, worker threads).
+    static bool LoadFromFile(ModelData& model, std::filesystem::path const& filePath, std::string& errorMessage, FileAccess access = FileAccess::Mapped);
 
 private:
     static bool LoadAny(ModelData& model, Packet& packet);
     static bool LoadV1(ModelData& model, Packet& packet);
     static bool LoadV3(ModelData& model, Packet& packet);
     static bool LoadV4(ModelData& model, Packet& packet);
-    static bool LoadMQO(ModelData& model, std::filesystem::path const& filePath);
+    static bool LoadMQO(ModelData& model, std::filesystem::path const& filePath, std::string& errorMessage, FileAccess access);
 
-    static bool ConvertFromMQO(ModelData& model, MQOFile const& mqoFile);
+    static bool ConvertFromMQO(ModelData& model, MQOFile const& mqoFile, std::string& errorMessage);
 };
 }
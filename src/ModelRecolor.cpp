@@ -0,0 +1,119 @@
+#include "ModelRecolor.h"
+
+#include "TextScan.h"
+
+#include <charconv>
+#include <limits>
+
+namespace imp {
+constexpr size_t kTableSize = 0x10000;
+
+template<typename T>
+static bool ParsePairs(std::string_view text, std::vector<std::pair<T, T>>& pairs, std::string& errorMessage)
+{
+    auto parseValue = [&](char const*& it, char const* end, T& value) {
+        int32_t parsed = 0;
+        auto [next, ec] = std::from_chars(it, end, parsed);
+        if (ec != std::errc() || parsed < std::numeric_limits<T>::min() || parsed > std::numeric_limits<T>::max()) {
+            errorMessage = "Expected a value between " + std::to_string(std::numeric_limits<T>::min()) + " and "
+                + std::to_string(std::numeric_limits<T>::max()) + (it == end ? " at the end" : " at '" + std::string(it, end) + "'");
+            return false;
+        }
+        value = static_cast<T>(parsed);
+        it = next;
+        return true;
+    };
+
+    char const* it = text.data();
+    char const* end = it + text.size();
+    for (;;) {
+        while (it != end && (text::IsSpace(*it) || *it == ',')) {
+            ++it;
+        }
+        if (it == end) {
+            return true;
+        }
+
+        T find;
+        T replace;
+        if (!parseValue(it, end, find)) {
+            return false;
+        }
+        it = text::SkipSpaces(it, end);
+        if (it == end || *it != '=') {
+            errorMessage = "Expected '=' after " + std::to_string(find);
+            return false;
+        }
+        it = text::SkipSpaces(it + 1, end);
+        if (!parseValue(it, end, replace)) {
+            return false;
+        }
+        pairs.emplace_back(find, replace);
+    }
+}
+
+// Replaces every entry currently equal to find. Running this per pair over
+// the whole table is what gives the in-order semantics, and the loop is a
+// plain compare-and-select the compiler turns into vector code.
+template<typename T>
+static void RemapTable(std::vector<T>& table, T find, T replace)
+{
+    T* entries = table.data();
+    for (size_t i = 0; i < kTableSize; ++i) {
+        entries[i] = entries[i] == find ? replace : entries[i];
+    }
+}
+
+bool RecolorDefinition::ParseColors(std::string_view text, RecolorDefinition& definition, std::string& errorMessage)
+{
+    return ParsePairs(text, definition.colors, errorMessage);
+}
+
+bool RecolorDefinition::ParseMaterials(std::string_view text, RecolorDefinition& definition, std::string& errorMessage)
+{
+    return ParsePairs(text, definition.materials, errorMessage);
+}
+
+ModelRecolor::ModelRecolor(RecolorDefinition const& definition)
+    : m_colors(kTableSize)
+{
+    for (size_t i = 0; i < kTableSize; ++i) {
+        m_colors[i] = static_cast<uint16_t>(i);
+    }
+    for (auto const& [find, replace] : definition.colors) {
+        RemapTable(m_colors, find, replace);
+    }
+
+    if (definition.materials.empty()) {
+        return;
+    }
+    m_materials.resize(kTableSize);
+    for (size_t i = 0; i < kTableSize; ++i) {
+        m_materials[i] = static_cast<int16_t>(i);
+    }
+    for (auto const& [find, replace] : definition.materials) {
+        RemapTable(m_materials, find, replace);
+    }
+}
+
+size_t ModelRecolor::Apply(ModelData& model) const
+{
+    uint16_t const* colors = m_colors.data();
+    int16_t const* materials = m_materials.empty() ? nullptr : m_materials.data();
+
+    size_t changed = 0;
+    for (Face& face : model.faces) {
+        uint16_t color = colors[face.color];
+        bool faceChanged = color != face.color;
+        face.color = color;
+
+        if (materials && face.material) {
+            int16_t material = materials[static_cast<uint16_t>(*face.material)];
+            faceChanged |= material != *face.material;
+            face.material = material;
+        }
+        changed += faceChanged;
+    }
+    return changed;
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Model.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace imp {
+// Client-style find/replace lists. Pairs are applied in order, so a later
+// pair also sees faces an earlier pair replaced, exactly as the client does.
+struct RecolorDefinition {
+    std::vector<std::pair<uint16_t, uint16_t>> colors;
+    std::vector<std::pair<int16_t, int16_t>> materials;
+
+    bool IsEmpty() const
+    {
+        return colors.empty() && materials.empty();
+    }
+
+    // Parses "find=replace" pairs separated by commas or whitespace, e.g.
+    // "6798=127, 8741=960".
+    static bool ParseColors(std::string_view text, RecolorDefinition& definition, std::string& errorMessage);
+    static bool ParseMaterials(std::string_view text, RecolorDefinition& definition, std::string& errorMessage);
+};
+
+// A definition folded into lookup tables indexed by the original value, so
+// recoloring a model costs one table read per face however many pairs there
+// are. Build it once and apply it to any number of models.
+class ModelRecolor {
+public:
+    explicit ModelRecolor(RecolorDefinition const& definition);
+
+    // Returns the number of faces that changed.
+    size_t Apply(ModelData& model) const;
+
+private:
+    std::vector<uint16_t> m_colors;
+    // Indexed by the material reinterpreted as unsigned, empty when the
+    // definition has no material pairs.
+    std::vector<int16_t> m_materials;
+};
+}
@@ -1,6 +1,5 @@
 #include "ModelRenderer.h"
 
-#include "Dialogs.h"
 #include "Renderer.h"
 #include "RunetekColor.h"
 // This comment is to prevent auto formatter from reorganizing glad to be after GLFW
@@ -8,12 +7,103 @@
 // ---------------------------------------------------------------------------------
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
 namespace imp {
 #define PTR_OFFSET(x) ((char*)nullptr + (x))
 #include "shaders/ModelGeom.fs"
+#include "shaders/ModelGeom.gs"
 #include "shaders/ModelGeom.vs"
-#include "shaders/ModelPick.fs"
-#include "shaders/ModelPick.vs"
+
+constexpr uint32_t kFaceDataTextureUnit = 0;
+constexpr uint32_t kHSLPaletteTextureUnit = 1;
+constexpr uint32_t kHelperPaletteTextureUnit = 2;
+constexpr uint32_t kFaceOrderTextureUnit = 3;
+// Two RGBA16UI texels per face, see AddFaceData.
+constexpr size_t kFaceDataValues = 8;
+// Stands in for an optional attribute the face does not have.
+constexpr uint16_t kMissingFaceValue = 0xffff;
+
+// Uploads the runs of faces (or vertices, with valuesPerFace = 1) whose data
+// differs between two builds of the buffer contents. Nearby runs are merged
+// so a scattered edit does not turn into thousands of tiny uploads; anything
+// past the end of the previous data is always uploaded.
+template<typename Buffer, typename T>
+static void UploadChangedRanges(Buffer& buffer, std::vector<T> const& previous, std::vector<T> const& current, size_t valuesPerFace)
+{
+    constexpr size_t kMergeDistance = 64;
+
+    size_t faceCount = current.size() / valuesPerFace;
+    size_t previousFaceCount = previous.size() / valuesPerFace;
+    size_t faceBytes = valuesPerFace * sizeof(T);
+
+    size_t runStart = 0;
+    size_t runEnd = 0;
+    bool inRun = false;
+    auto flush = [&] {
+        buffer.Update(static_cast<uint32_t>(runStart * faceBytes), static_cast<uint32_t>((runEnd - runStart) * faceBytes), current.data() + runStart * valuesPerFace);
+        inRun = false;
+    };
+
+    for (size_t face = 0; face < faceCount; ++face) {
+        bool changed = face >= previousFaceCount
+            || std::memcmp(current.data() + face * valuesPerFace, previous.data() + face * valuesPerFace, faceBytes) != 0;
+        if (!changed) {
+            continue;
+        }
+        if (inRun && face - runEnd > kMergeDistance) {
+            flush();
+        }
+        if (!inRun) {
+            runStart = face;
+            inRun = true;
+        }
+        runEnd = face + 1;
+    }
+    if (inRun) {
+        flush();
+    }
+}
+
+// Stable LSD radix sort on the 16-bit keys in bits 32-47, a byte per pass.
+// Two passes leave the result back in items.
+static void RadixSortByKey(std::vector<uint64_t>& items, std::vector<uint64_t>& scratch)
+{
+    uint32_t offsets[2][256] {};
+    for (uint64_t item : items) {
+        ++offsets[0][(item >> 32) & 0xff];
+        ++offsets[1][(item >> 40) & 0xff];
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        uint32_t offset = 0;
+        for (uint32_t& bucket : offsets[pass]) {
+            uint32_t count = bucket;
+            bucket = offset;
+            offset += count;
+        }
+        int shift = 32 + pass * 8;
+        for (uint64_t item : items) {
+            scratch[offsets[pass][(item >> shift) & 0xff]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+static uint8_t FacePriority(Face const& face, ModelData const& modelData)
+{
+    if (face.priority) {
+        return static_cast<uint8_t>(*face.priority);
+    }
+    return modelData.priority.value_or(0);
+}
+
+static bool IsTranslucent(Face const& face)
+{
+    return face.trans && *face.trans != 0;
+}
 
 ModelRenderer::ModelRenderer()
 {
@@ -24,11 +114,12 @@ ModelRenderer::~ModelRenderer()
 {
     glDeleteVertexArrays(1, &m_vao);
     m_vertexVBO.Destroy();
-    m_colorVBO.Destroy();
     m_elementBuffer.Destroy();
-    glDeleteFramebuffers(1, &m_pickingFBO);
-    glDeleteTextures(1, &m_pickingTexture);
-    glDeleteRenderbuffers(1, &m_pickingDepthRBO);
+    m_faceBuffer.Destroy();
+    m_faceOrderBuffer.Destroy();
+    m_uploadRing.Destroy();
+    glDeleteTextures(1, &m_hslPaletteTexture);
+    glDeleteTextures(1, &m_helperPaletteTexture);
 }
 
 void ModelRenderer::Initialize()
@@ -36,71 +127,143 @@ void ModelRenderer::Initialize()
     SetupShaders();
 
     glGenVertexArrays(1, &m_vao);
-    constexpr uint32_t kMaxVertexCount = 65535;
-    constexpr uint32_t kMaxIndexCount = 65535;
-    m_vertexVBO.Create(kMaxVertexCount * 5 * sizeof(float), BUFFER_FLAG_DYNAMIC, nullptr);
-    m_colorVBO.Create(kMaxVertexCount * 4 * sizeof(float), BUFFER_FLAG_DYNAMIC, nullptr);
-    m_elementBuffer.Create(kMaxIndexCount * sizeof(uint32_t), BUFFER_FLAG_DYNAMIC, nullptr);
-    SetupPickingFramebuffer();
+    // Starting sizes only, the buffers grow to fit larger models.
+    constexpr uint32_t kInitialVertexCount = 65535;
+    constexpr uint32_t kInitialFaceCount = 65535;
+    constexpr uint32_t kUploadRingSize = 8 << 20;
+    m_vertexVBO.Create(kInitialVertexCount * sizeof(ModelVertex), BUFFER_FLAG_DYNAMIC, nullptr);
+    m_elementBuffer.Create(kInitialFaceCount * 3 * sizeof(uint16_t), BUFFER_FLAG_DYNAMIC, nullptr);
+    m_faceBuffer.Create(kInitialFaceCount * kFaceDataValues * sizeof(uint16_t), GL_RGBA16UI, BUFFER_FLAG_DYNAMIC, nullptr);
+    m_faceOrderBuffer.Create(kInitialFaceCount * sizeof(uint32_t), GL_R32UI, BUFFER_FLAG_DYNAMIC, nullptr);
+    if (m_uploadRing.Create(kUploadRingSize)) {
+        m_vertexVBO.SetUploadRing(&m_uploadRing);
+        m_elementBuffer.SetUploadRing(&m_uploadRing);
+        m_faceBuffer.SetUploadRing(&m_uploadRing);
+        m_faceOrderBuffer.SetUploadRing(&m_uploadRing);
+    }
+    SetupPaletteTextures();
+}
+
+void ModelRenderer::SetupPaletteTextures()
+{
+    // The tables hold 0x00RRGGBB words, which BGRA with the reversed packed
+    // type reads as-is on any endianness. Alpha comes out as zero and is
+    // replaced in the shader.
+    auto createPalette = [](uint32_t& texture, int width, int height, uint32_t const* data) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    };
+
+    // Indexed as (hsl & 0xff, hsl >> 8).
+    createPalette(m_hslPaletteTexture, 256, 256, math::RunetekColor::GetHSLPalette().data());
+    std::span<uint32_t const> helperPalette = math::RunetekColor::GetHelperPalette();
+    createPalette(m_helperPaletteTexture, static_cast<int>(helperPalette.size()), 1, helperPalette.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void ModelRenderer::SetupShaders()
 {
-    m_shaderProgram.Create(modelGeomVertexShader, modelGeomFragmentShader);
-    m_pickingShaderProgram.Create(modelPickVertexShader, modelPickFragmentShader);
+    m_shaderProgram.Create(modelGeomVertexShader, modelGeomFragmentShader, modelGeomGeometryShader);
+    m_shaderProgram.BindUniformBlock("Camera", kCameraUniformBinding);
+    m_uniforms.highlightFace = m_shaderProgram.GetUniform<int>("uHighlightFace");
+    m_uniforms.selectedFace = m_shaderProgram.GetUniform<int>("uSelectedFace");
+    m_uniforms.highlightVertex = m_shaderProgram.GetUniform<int>("uHighlightVertex");
+    m_uniforms.selectedVertex = m_shaderProgram.GetUniform<int>("uSelectedVertex");
+    m_uniforms.highlightColor = m_shaderProgram.GetUniform<glm::vec4>("uHighlightColor");
+    m_uniforms.selectedColor = m_shaderProgram.GetUniform<glm::vec4>("uSelectedColor");
+    m_uniforms.vertexMode = m_shaderProgram.GetUniform<int>("uVertexMode");
+    m_uniforms.wireframe = m_shaderProgram.GetUniform<int>("uWireframe");
+    m_uniforms.wireframeColor = m_shaderProgram.GetUniform<glm::vec4>("uWireframeColor");
+    m_uniforms.wireframeWidth = m_shaderProgram.GetUniform<float>("uWireframeWidth");
+    m_uniforms.vertexSize = m_shaderProgram.GetUniform<float>("uVertexSize");
+    m_uniforms.viewportSize = m_shaderProgram.GetUniform<glm::vec2>("uViewportSize");
+    m_uniforms.colorMode = m_shaderProgram.GetUniform<int>("uColorMode");
+    m_uniforms.firstPrimitive = m_shaderProgram.GetUniform<int>("uFirstPrimitive");
+
+    // The samplers always read the same units.
+    m_shaderProgram.Bind();
+    m_shaderProgram.GetUniform<int>("uFaceData").Set(static_cast<int>(kFaceDataTextureUnit));
+    m_shaderProgram.GetUniform<int>("uHSLPalette").Set(static_cast<int>(kHSLPaletteTextureUnit));
+    m_shaderProgram.GetUniform<int>("uHelperPalette").Set(static_cast<int>(kHelperPaletteTextureUnit));
+    m_shaderProgram.GetUniform<int>("uFaceOrder").Set(static_cast<int>(kFaceOrderTextureUnit));
+    glUseProgram(0);
+}
+
+void ModelRenderer::SetModelData(std::shared_ptr<ModelData> const& modelData)
+{
+    m_modelData = modelData;
+    UpdateBuffers(*modelData);
+    m_dirty = true;
 }
 
-void ModelRenderer::SetupPickingFramebuffer()
+void ModelRenderer::UpdateModelData(std::shared_ptr<ModelData> const& modelData)
 {
-    glGenFramebuffers(1, &m_pickingFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_pickingFBO);
-
-    glGenTextures(1, &m_pickingTexture);
-    glBindTexture(GL_TEXTURE_2D, m_pickingTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_viewportWidth, m_viewportHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_pickingTexture, 0);
-
-    glGenRenderbuffers(1, &m_pickingDepthRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_pickingDepthRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_viewportWidth, m_viewportHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_pickingDepthRBO);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        ShowFatalDialog("Error", "Picking framebuffer is not complete!");
-        std::exit(1);
+    if (!m_modelData) {
+        SetModelData(modelData);
+        return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    std::vector<ModelVertex> previousVertexData = std::move(m_vertexData);
+    std::vector<uint16_t> previousFaceData = std::move(m_faceData);
+    std::vector<uint16_t> previousDrawIndices = std::move(m_drawIndices);
+    std::vector<uint32_t> previousDrawFaces = std::move(m_drawFaces);
+
+    m_modelData = modelData;
+    BuildVertexData(*modelData);
+    m_bvh.Build(*modelData);
+
+    UploadChangedRanges(m_vertexVBO, previousVertexData, m_vertexData, 1);
+    UploadChangedRanges(m_faceBuffer, previousFaceData, m_faceData, kFaceDataValues);
+    UploadChangedRanges(m_elementBuffer, previousDrawIndices, m_drawIndices, 3);
+    UploadChangedRanges(m_faceOrderBuffer, previousDrawFaces, m_drawFaces, 1);
+    m_dirty = true;
+
+    SetHoveredFace(m_hoveredFace);
+    SetSelectedFace(m_selectedFace);
+    SetHoveredVertex(m_hoveredVertex);
+    SetSelectedVertex(m_selectedVertex);
 }
 
-void ModelRenderer::SetViewportSize(int width, int height)
+void ModelRenderer::UpdateFaceData(std::shared_ptr<ModelData> const& modelData)
 {
-    if (width == m_viewportWidth && height == m_viewportHeight) {
+    if (!m_modelData || m_modelData->faces.size() != modelData->faces.size()) {
+        UpdateModelData(modelData);
         return;
     }
 
-    m_viewportWidth = width;
-    m_viewportHeight = height;
+    std::vector<uint16_t> previousFaceData = std::move(m_faceData);
+    std::vector<uint16_t> previousDrawIndices = m_drawIndices;
+    std::vector<uint32_t> previousDrawFaces = m_drawFaces;
 
-    glBindTexture(GL_TEXTURE_2D, m_pickingTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    m_modelData = modelData;
+    m_faceData.clear();
+    for (Face const& face : modelData->faces) {
+        AddFaceData(face);
+    }
+    // Priority and transparency are face attributes too.
+    BuildDrawOrder(*modelData);
 
-    glBindRenderbuffer(GL_RENDERBUFFER, m_pickingDepthRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+    UploadChangedRanges(m_faceBuffer, previousFaceData, m_faceData, kFaceDataValues);
+    UploadChangedRanges(m_elementBuffer, previousDrawIndices, m_drawIndices, 3);
+    UploadChangedRanges(m_faceOrderBuffer, previousDrawFaces, m_drawFaces, 1);
+    m_dirty = true;
 }
 
-void ModelRenderer::SetModelData(std::shared_ptr<ModelData> const& modelData)
+void ModelRenderer::UpdateBuffers(ModelData const& modelData)
 {
-    m_modelData = modelData;
-    UpdateBuffers(*modelData);
+    BuildVertexData(modelData);
+    UploadVertexData();
+    m_bvh.Build(modelData);
 }
 
-void ModelRenderer::UpdateBuffers(ModelData const& modelData)
+void ModelRenderer::BuildVertexData(ModelData const& modelData)
 {
     m_vertexData.clear();
-    m_colorData.clear();
+    m_faceData.clear();
     m_indices.clear();
 
     std::vector<Vertex> const& vertices = modelData.vertices;
@@ -108,64 +271,137 @@ void ModelRenderer::UpdateBuffers(ModelData const& modelData)
     m_vertexCount = static_cast<int32_t>(vertices.size());
     m_faceCount = static_cast<int32_t>(faces.size());
 
-    uint32_t indexCounter = 0;
-    for (size_t i = 0; i < faces.size(); ++i) {
-        Face const& face = faces[i];
-
-        uint32_t rgb = math::RunetekColor::HSLToRGB(face.color);
-        float r = static_cast<float>(rgb >> 16 & 0xff) / 255.0f;
-        float g = static_cast<float>(rgb >> 8 & 0xff) / 255.0f;
-        float b = static_cast<float>(rgb & 0xff) / 255.0f;
+    m_vertexData.reserve(vertices.size());
+    for (Vertex const& vertex : vertices) {
+        m_vertexData.push_back({ vertex.x, vertex.y, vertex.z, 0 });
+    }
 
-        AddFaceVertices(face, vertices, static_cast<int>(i));
-        AddVertexColors(r, g, b);
+    m_indices.reserve(faces.size() * 3);
+    m_faceData.reserve(faces.size() * kFaceDataValues);
+    for (Face const& face : faces) {
+        m_indices.push_back(face.v3);
+        m_indices.push_back(face.v2);
+        m_indices.push_back(face.v1);
+        AddFaceData(face);
+    }
+    BuildDrawOrder(modelData);
+}
 
-        m_indices.push_back(indexCounter + 2);
-        m_indices.push_back(indexCounter + 1);
-        m_indices.push_back(indexCounter);
-        indexCounter += 3;
+void ModelRenderer::BuildDrawOrder(ModelData const& modelData)
+{
+    std::vector<Face> const& faces = modelData.faces;
+    uint32_t faceCount = static_cast<uint32_t>(faces.size());
+
+    // A stable counting sort by priority, opaque and translucent faces
+    // counted apart so each group comes out in priority order.
+    uint32_t opaqueOffsets[256] {};
+    uint32_t translucentOffsets[256] {};
+    for (Face const& face : faces) {
+        ++(IsTranslucent(face) ? translucentOffsets : opaqueOffsets)[FacePriority(face, modelData)];
+    }
+    uint32_t opaqueCount = 0;
+    uint32_t translucentCount = 0;
+    for (int priority = 0; priority < 256; ++priority) {
+        uint32_t count = opaqueOffsets[priority];
+        opaqueOffsets[priority] = opaqueCount;
+        opaqueCount += count;
+        count = translucentOffsets[priority];
+        translucentOffsets[priority] = translucentCount;
+        translucentCount += count;
     }
 
-    UploadVertexData();
+    m_opaqueFaceCount = opaqueCount;
+    m_drawIndices.resize(static_cast<size_t>(faceCount) * 3);
+    m_drawFaces.resize(faceCount);
+    m_translucentFaces.resize(translucentCount);
+    for (uint32_t face = 0; face < faceCount; ++face) {
+        uint8_t priority = FacePriority(faces[face], modelData);
+        if (IsTranslucent(faces[face])) {
+            m_translucentFaces[translucentOffsets[priority]++] = face;
+        } else {
+            WriteDrawFace(opaqueOffsets[priority]++, face);
+        }
+    }
 
-    if (m_colorMode != ColorMode::Diffuse) {
-        UpdateColorData();
+    // Translucent faces are drawn in priority order until the first sort.
+    std::vector<Vertex> const& vertices = modelData.vertices;
+    m_translucentCentroids.resize(translucentCount);
+    for (uint32_t i = 0; i < translucentCount; ++i) {
+        uint32_t face = m_translucentFaces[i];
+        WriteDrawFace(opaqueCount + i, face);
+
+        glm::vec3 sum(0.0f);
+        for (int corner = 0; corner < 3; ++corner) {
+            uint16_t index = m_indices[face * 3 + corner];
+            if (index < vertices.size()) {
+                sum += glm::vec3(vertices[index].x, -vertices[index].y, vertices[index].z);
+            }
+        }
+        m_translucentCentroids[i] = sum / 3.0f;
     }
+    m_sortItems.resize(translucentCount);
+    m_sortScratch.resize(translucentCount);
+    m_translucentSorted = false;
 }
 
-void ModelRenderer::AddFaceVertices(Face const& face, std::vector<Vertex> const& vertices, int faceIndex)
+void ModelRenderer::WriteDrawFace(uint32_t slot, uint32_t face)
 {
-    Vertex const& v1 = vertices[face.v1];
-    Vertex const& v2 = vertices[face.v2];
-    Vertex const& v3 = vertices[face.v3];
-
-    m_vertexData.push_back(v1.x);
-    m_vertexData.push_back(static_cast<float>(-v1.y));
-    m_vertexData.push_back(v1.z);
-    m_vertexData.push_back(face.v1);
-    m_vertexData.push_back(static_cast<float>(faceIndex));
-
-    m_vertexData.push_back(v2.x);
-    m_vertexData.push_back(static_cast<float>(-v2.y));
-    m_vertexData.push_back(v2.z);
-    m_vertexData.push_back(face.v2);
-    m_vertexData.push_back(static_cast<float>(faceIndex));
-
-    m_vertexData.push_back(v3.x);
-    m_vertexData.push_back(static_cast<float>(-v3.y));
-    m_vertexData.push_back(v3.z);
-    m_vertexData.push_back(face.v3);
-    m_vertexData.push_back(static_cast<float>(faceIndex));
+    m_drawFaces[slot] = face;
+    std::memcpy(&m_drawIndices[slot * 3], &m_indices[face * 3], 3 * sizeof(uint16_t));
 }
 
-void ModelRenderer::AddVertexColors(float r, float g, float b)
+void ModelRenderer::SortTranslucentFaces(glm::mat4 const& viewMatrix)
 {
-    for (int i = 0; i < 3; i++) {
-        m_colorData.push_back(r);
-        m_colorData.push_back(g);
-        m_colorData.push_back(b);
-        m_colorData.push_back(1.0f);
+    if (m_translucentFaces.empty() || (m_translucentSorted && viewMatrix == m_sortedViewMatrix)) {
+        return;
+    }
+    m_sortedViewMatrix = viewMatrix;
+    m_translucentSorted = true;
+
+    // Distance in front of the camera is -z in view space.
+    glm::vec4 depthRow(-viewMatrix[0][2], -viewMatrix[1][2], -viewMatrix[2][2], -viewMatrix[3][2]);
+    auto depthOf = [&depthRow](glm::vec3 const& point) {
+        return depthRow.x * point.x + depthRow.y * point.y + depthRow.z * point.z + depthRow.w;
+    };
+
+    float nearest = std::numeric_limits<float>::max();
+    float farthest = std::numeric_limits<float>::lowest();
+    for (glm::vec3 const& centroid : m_translucentCentroids) {
+        float depth = depthOf(centroid);
+        nearest = std::min(nearest, depth);
+        farthest = std::max(farthest, depth);
+    }
+
+    // Quantize to 16 bits with the farthest face first. The faces go in by
+    // priority and the sort is stable, so priority breaks depth ties.
+    float scale = farthest > nearest ? 65535.0f / (farthest - nearest) : 0.0f;
+    for (size_t i = 0; i < m_translucentFaces.size(); ++i) {
+        uint64_t key = 65535 - static_cast<uint32_t>((depthOf(m_translucentCentroids[i]) - nearest) * scale);
+        m_sortItems[i] = (key << 32) | m_translucentFaces[i];
     }
+    RadixSortByKey(m_sortItems, m_sortScratch);
+
+    uint32_t translucentCount = static_cast<uint32_t>(m_sortItems.size());
+    for (uint32_t i = 0; i < translucentCount; ++i) {
+        WriteDrawFace(m_opaqueFaceCount + i, static_cast<uint32_t>(m_sortItems[i]));
+    }
+    m_elementBuffer.Update(m_opaqueFaceCount * 3 * sizeof(uint16_t), translucentCount * 3 * sizeof(uint16_t), &m_drawIndices[m_opaqueFaceCount * 3]);
+    m_faceOrderBuffer.Update(m_opaqueFaceCount * sizeof(uint32_t), translucentCount * sizeof(uint32_t), &m_drawFaces[m_opaqueFaceCount]);
+}
+
+void ModelRenderer::AddFaceData(Face const& face)
+{
+    // Everything a color mode can show is uploaded up front, so switching
+    // modes is a uniform write. Signed bytes go up as their unsigned bit
+    // pattern, which is how the helper palette is indexed.
+    m_faceData.push_back(face.color);
+    m_faceData.push_back(face.label ? *face.label : kMissingFaceValue);
+    m_faceData.push_back(face.priority ? static_cast<uint8_t>(*face.priority) : kMissingFaceValue);
+    m_faceData.push_back(face.trans ? static_cast<uint8_t>(*face.trans) : kMissingFaceValue);
+    m_faceData.push_back(face.material ? static_cast<uint16_t>(*face.material) : kMissingFaceValue);
+    m_faceData.push_back(face.mapping ? *face.mapping : kMissingFaceValue);
+    m_faceData.push_back(face.type ? *face.type : kMissingFaceValue);
+    m_faceData.push_back(0);
 }
 
 void ModelRenderer::UploadVertexData()
@@ -173,213 +409,88 @@ void ModelRenderer::UploadVertexData()
     if (m_vao == 0) {
         glGenVertexArrays(1, &m_vao);
     }
-    m_vertexVBO.Update(0, m_vertexData.size() * sizeof(float), m_vertexData.data());
-    m_colorVBO.Update(0, m_colorData.size() * sizeof(float), m_colorData.data());
-    m_elementBuffer.Update(0, m_indices.size() * sizeof(uint32_t), m_indices.data());
+    m_vertexVBO.Update(0, m_vertexData.size() * sizeof(ModelVertex), m_vertexData.data());
+    m_faceBuffer.Update(0, m_faceData.size() * sizeof(uint16_t), m_faceData.data());
+    m_elementBuffer.Update(0, m_drawIndices.size() * sizeof(uint16_t), m_drawIndices.data());
+    m_faceOrderBuffer.Update(0, m_drawFaces.size() * sizeof(uint32_t), m_drawFaces.data());
 
     glBindVertexArray(m_vao);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBuffer.GetNativeBuffer());
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexVBO.GetNativeBuffer());
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), PTR_OFFSET(0));
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(ModelVertex), PTR_OFFSET(offsetof(ModelVertex, x)));
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), PTR_OFFSET(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), PTR_OFFSET(4 * sizeof(float)));
-    glEnableVertexAttribArray(3);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO.GetNativeBuffer());
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), PTR_OFFSET(0));
-    glEnableVertexAttribArray(1);
-
     glBindVertexArray(0);
 }
 
-void ModelRenderer::Render(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
+void ModelRenderer::Render()
 {
+    m_dirty = false;
     if (m_indices.empty()) {
         return;
     }
 
     m_shaderProgram.Bind();
-    m_shaderProgram.SetUniform("uViewMatrix", viewMatrix);
-    m_shaderProgram.SetUniform("uProjectionMatrix", projectionMatrix);
-    m_shaderProgram.SetUniform("uHighlightFace", m_hoveredFace);
-    m_shaderProgram.SetUniform("uSelectedFace", m_selectedFace);
-    m_shaderProgram.SetUniform("uHighlightVertex", m_hoveredVertex);
-    m_shaderProgram.SetUniform("uSelectedVertex", m_selectedVertex);
-    m_shaderProgram.SetUniform("uHighlightColor", m_highlightColor);
-    m_shaderProgram.SetUniform("uSelectedColor", m_selectedColor);
-    m_shaderProgram.SetUniform("uOverrideColorEnabled", 0);
-    m_shaderProgram.SetUniform("uVertexMode", m_vertexMode ? 1 : 0);
-    m_shaderProgram.SetUniform("uHighlight", m_vertexMode ? 0 : 1);
+    m_uniforms.highlightFace.Set(m_hoveredFace);
+    m_uniforms.selectedFace.Set(m_selectedFace);
+    m_uniforms.highlightVertex.Set(m_hoveredVertex);
+    m_uniforms.selectedVertex.Set(m_selectedVertex);
+    m_uniforms.highlightColor.Set(m_highlightColor);
+    m_uniforms.selectedColor.Set(m_selectedColor);
+    m_uniforms.vertexMode.Set(m_vertexMode ? 1 : 0);
+    // Vertex mode shows the edges the vertices sit on as well.
+    m_uniforms.wireframe.Set(m_wireframeMode || m_vertexMode ? 1 : 0);
+    m_uniforms.wireframeColor.Set(m_wireframeColor);
+    m_uniforms.wireframeWidth.Set(m_wireframeWidth);
+    m_uniforms.vertexSize.Set(m_vertexSize);
+    m_uniforms.viewportSize.Set(m_viewportSize);
+    m_uniforms.colorMode.Set(static_cast<int>(m_colorMode));
+
+    m_faceBuffer.Bind(kFaceDataTextureUnit);
+    m_faceOrderBuffer.Bind(kFaceOrderTextureUnit);
+    glActiveTexture(GL_TEXTURE0 + kHSLPaletteTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, m_hslPaletteTexture);
+    glActiveTexture(GL_TEXTURE0 + kHelperPaletteTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, m_helperPaletteTexture);
+    glActiveTexture(GL_TEXTURE0);
 
     glBindVertexArray(m_vao);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
-
-    if (m_wireframeMode || m_vertexMode) {
-        RenderWireframe(viewMatrix, projectionMatrix);
-    }
-    if (m_vertexMode) {
-        RenderPoints(viewMatrix, projectionMatrix);
-    }
-    glBindVertexArray(0);
-}
-
-void ModelRenderer::RenderWireframe(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
-{
-    glDepthMask(GL_FALSE);
-    glEnable(GL_POLYGON_OFFSET_LINE);
-    glPolygonOffset(-1.0f, -1.0f);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    m_shaderProgram.SetUniform("uOverrideColorEnabled", 1);
-    m_shaderProgram.SetUniform("uOverrideColor", m_wireframeColor);
-    m_shaderProgram.SetUniform("uHighlightVertex", m_hoveredVertex);
-    m_shaderProgram.SetUniform("uSelectedVertex", m_selectedVertex);
-    m_shaderProgram.SetUniform("uHighlight", 0);
-    glLineWidth(1.0f);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDisable(GL_POLYGON_OFFSET_LINE);
-    glDepthMask(GL_TRUE);
-}
-
-void ModelRenderer::RenderPoints(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
-{
-    m_shaderProgram.Bind();
-    m_shaderProgram.SetUniform("uViewMatrix", viewMatrix);
-    m_shaderProgram.SetUniform("uProjectionMatrix", projectionMatrix);
-    m_shaderProgram.SetUniform("uOverrideColorEnabled", 1);
-    m_shaderProgram.SetUniform("uOverrideColor", m_wireframeColor);
-    m_shaderProgram.SetUniform("uHighlight", m_vertexMode ? 1 : 0);
-
-    glEnable(GL_POLYGON_OFFSET_LINE);
-    glPolygonOffset(-1.0f, -1.0f);
-    glBindVertexArray(m_vao);
-    glPointSize(5.0f);
-    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_vertexData.size() / 4));
-    glBindVertexArray(0);
-    glDisable(GL_POLYGON_OFFSET_LINE);
-}
-
-void ModelRenderer::RenderForPicking(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
-{
-    if (m_indices.empty()) {
-        return;
-    }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_pickingFBO);
-    glViewport(0, 0, m_viewportWidth, m_viewportHeight);
 
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    m_pickingShaderProgram.Bind();
-
-    m_pickingShaderProgram.SetUniform("uViewMatrix", viewMatrix);
-    m_pickingShaderProgram.SetUniform("uProjectionMatrix", projectionMatrix);
-    m_pickingShaderProgram.SetUniform("uVertexMode", m_vertexMode ? 1 : 0);
-
-    glBindVertexArray(m_vao);
-    if (m_vertexMode) {
-        glPointSize(10.0f);
-        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_vertexData.size() / 4));
-    } else {
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
+    // Opaque faces go in priority order, and LEQUAL lets a later face win
+    // over a coplanar one, which is how the client layers decals.
+    glDepthFunc(GL_LEQUAL);
+    m_uniforms.firstPrimitive.Set(0);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_opaqueFaceCount * 3), GL_UNSIGNED_SHORT, nullptr);
+    glDepthFunc(GL_LESS);
+
+    // Translucent faces are blended back to front. Only the diffuse mode
+    // shows them translucent, the others draw them solid. The renderer draws
+    // the model with blending off, so it is switched on just for this pass.
+    uint32_t translucentCount = static_cast<uint32_t>(m_faceCount) - m_opaqueFaceCount;
+    if (translucentCount > 0) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(m_colorMode == ColorMode::Diffuse ? GL_FALSE : GL_TRUE);
+        m_uniforms.firstPrimitive.Set(static_cast<int>(m_opaqueFaceCount));
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(translucentCount * 3), GL_UNSIGNED_SHORT, PTR_OFFSET(m_opaqueFaceCount * 3 * sizeof(uint16_t)));
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
     }
     glBindVertexArray(0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-int ModelRenderer::Pick(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
+int ModelRenderer::Pick(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix) const
 {
-    if (m_indices.empty()) {
+    if (m_bvh.IsEmpty() || x < 0 || y < 0 || x >= viewportWidth || y >= viewportHeight) {
         return -1;
     }
-    SetViewportSize(viewportWidth, viewportHeight);
-    RenderForPicking(viewMatrix, projectionMatrix);
-
-    unsigned char data[4];
-    glBindFramebuffer(GL_FRAMEBUFFER, m_pickingFBO);
-    y = viewportHeight - y;
-
-    glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    int selection = data[0] | (data[1] << 8) | (data[2] << 16);
-    if (selection == 0 && (data[0] == 0 && data[1] == 0 && data[2] == 0)) {
-        return -1;
-    }
+    Ray ray = ModelBVH::RayFromViewport(x, y, viewportWidth, viewportHeight, viewMatrix, projectionMatrix);
     if (m_vertexMode) {
-        if (selection >= m_vertexCount) {
-            return -1;
-        }
-    } else {
-        if (selection >= m_faceCount) {
-            return -1;
-        }
-    }
-    return selection;
-}
-
-void ModelRenderer::UpdateColorData()
-{
-    if (!m_modelData || m_modelData->faces.empty()) {
-        return;
-    }
-
-    auto const& faces = m_modelData->faces;
-
-    m_colorData.clear();
-
-    for (size_t i = 0; i < faces.size(); ++i) {
-        auto const& face = faces[i];
-        float r = 0.0f;
-        float g = 0.0f;
-        float b = 0.0f;
-        uint32_t rgb = 0;
-
-        switch (m_colorMode) {
-        case ColorMode::Diffuse:
-            rgb = math::RunetekColor::HSLToRGB(face.color);
-            break;
-
-        case ColorMode::Priority:
-            if (face.priority) {
-                rgb = math::RunetekColor::HelperToRGB(*face.priority);
-            } else {
-                r = 0.7f;
-                g = 0.7f;
-                b = 0.7f;
-                AddVertexColors(r, g, b);
-                continue;
-            }
-            break;
-
-        case ColorMode::Label:
-            if (face.label) {
-                rgb = math::RunetekColor::HelperToRGB(*face.label);
-            } else {
-                r = 0.5f;
-                g = 0.5f;
-                b = 0.5f;
-                AddVertexColors(r, g, b);
-                continue;
-            }
-            break;
-        }
-
-        r = static_cast<float>(rgb >> 16 & 0xff) / 255.0f;
-        g = static_cast<float>(rgb >> 8 & 0xff) / 255.0f;
-        b = static_cast<float>(rgb & 0xff) / 255.0f;
-
-        AddVertexColors(r, g, b);
+        return m_bvh.RaycastVertex(ray);
     }
-
-    m_colorVBO.Update(0, m_colorData.size() * sizeof(float), m_colorData.data());
+    return m_bvh.Raycast(ray).face;
 }
 }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Model.h"
+#include "ModelBVH.h"
 
 #include "ShaderProgram.h"
 #include "render/IndexBuffer.h"
+#include "render/TextureBuffer.h"
+#include "render/UploadRing.h"
 #include "render/VertexBuffer.h"
 
 #include <glm/glm.hpp>
@@ -11,12 +14,26 @@
 #include <vector>
 
 namespace imp {
+// Values are shared with the ModelGeom fragment shader.
 enum class ColorMode : uint8_t {
     Diffuse,
     Priority,
-    Label
+    Label,
+    Trans,
+    Material,
+    Mapping
 };
 
+// A model vertex as uploaded. Model coordinates are int16, so they go to the
+// GPU as shorts, padded to keep every vertex 4-byte aligned.
+struct ModelVertex {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    int16_t padding;
+};
+static_assert(sizeof(ModelVertex) == 8);
+
 class ModelRenderer {
 public:
     ModelRenderer();
@@ -24,10 +41,28 @@ public:
 
     void Initialize();
     void SetModelData(std::shared_ptr<ModelData> const& modelData);
-    void Render(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
+    // Replaces the model with a new revision of the same model, uploading only
+    // the parts of the buffers that changed and keeping the selection.
+    void UpdateModelData(std::shared_ptr<ModelData> const& modelData);
+    // Same as above for a revision that only differs in per-face attributes
+    // such as colors, so the geometry is not rebuilt at all.
+    void UpdateFaceData(std::shared_ptr<ModelData> const& modelData);
+    // Re-sorts the translucent faces back to front for a camera, if it moved
+    // since the last sort. Call before Render.
+    void SortTranslucentFaces(glm::mat4 const& viewMatrix);
+    // Draws with the matrices in the Camera uniform block, which the caller
+    // binds at kCameraUniformBinding.
+    void Render();
+
+    // Whether anything drawn by Render changed since it last ran.
+    bool IsDirty() const
+    {
+        return m_dirty;
+    }
 
-    int Pick(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
-    void SetViewportSize(int width, int height);
+    // Returns the face or vertex under the cursor, found by casting a ray
+    // through the model's BVH. y counts down from the top of the viewport.
+    int Pick(int x, int y, int viewportWidth, int viewportHeight, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix) const;
 
     int GetHoveredFace() const
     {
@@ -37,10 +72,10 @@ public:
     void SetHoveredFace(int faceIndex)
     {
         if (faceIndex < -1 || faceIndex >= m_faceCount) {
-            m_hoveredFace = -1;
-        } else {
-            m_hoveredFace = faceIndex;
+            faceIndex = -1;
         }
+        m_dirty = m_dirty || faceIndex != m_hoveredFace;
+        m_hoveredFace = faceIndex;
     }
 
     int GetSelectedFace() const
@@ -51,10 +86,10 @@ public:
     void SetSelectedFace(int faceIndex)
     {
         if (faceIndex < -1 || faceIndex >= m_faceCount) {
-            m_selectedFace = -1;
-        } else {
-            m_selectedFace = faceIndex;
+            faceIndex = -1;
         }
+        m_dirty = m_dirty || faceIndex != m_selectedFace;
+        m_selectedFace = faceIndex;
     }
 
     int GetHoveredVertex() const
@@ -65,10 +100,10 @@ public:
     void SetHoveredVertex(int vertexIndex)
     {
         if (vertexIndex < -1 || vertexIndex >= m_vertexCount) {
-            m_hoveredVertex = -1;
-        } else {
-            m_hoveredVertex = vertexIndex;
+            vertexIndex = -1;
         }
+        m_dirty = m_dirty || vertexIndex != m_hoveredVertex;
+        m_hoveredVertex = vertexIndex;
     }
 
     int GetSelectedVertex() const
@@ -79,10 +114,10 @@ public:
     void SetSelectedVertex(int vertexIndex)
     {
         if (vertexIndex < -1 || vertexIndex >= m_vertexCount) {
-            m_selectedVertex = -1;
-        } else {
-            m_selectedVertex = vertexIndex;
+            vertexIndex = -1;
         }
+        m_dirty = m_dirty || vertexIndex != m_selectedVertex;
+        m_selectedVertex = vertexIndex;
     }
 
     std::shared_ptr<ModelData> const& GetModelData() const
@@ -90,82 +125,149 @@ public:
         return m_modelData;
     }
 
+    ModelBVH const& GetBVH() const
+    {
+        return m_bvh;
+    }
+
     void SetWireframeMode(bool enabled)
     {
+        m_dirty = m_dirty || enabled != m_wireframeMode;
         m_wireframeMode = enabled;
     }
 
     void SetVertexMode(bool enabled)
     {
+        m_dirty = m_dirty || enabled != m_vertexMode;
         m_vertexMode = enabled;
     }
 
     void SetHighlightColor(glm::vec4 const& color)
     {
+        m_dirty = m_dirty || color != m_highlightColor;
         m_highlightColor = color;
     }
 
     void SetSelectedColor(glm::vec4 const& color)
     {
+        m_dirty = m_dirty || color != m_selectedColor;
         m_selectedColor = color;
     }
 
     void SetWireframeColor(glm::vec4 const& color)
     {
+        m_dirty = m_dirty || color != m_wireframeColor;
         m_wireframeColor = color;
     }
 
+    // Line width of the wireframe, in pixels.
+    void SetWireframeWidth(float width)
+    {
+        m_dirty = m_dirty || width != m_wireframeWidth;
+        m_wireframeWidth = width;
+    }
+
+    // Diameter of the vertex dots in vertex mode, in pixels.
+    void SetVertexSize(float size)
+    {
+        m_dirty = m_dirty || size != m_vertexSize;
+        m_vertexSize = size;
+    }
+
+    // The wireframe and vertex dots are measured in pixels, so they need
+    // the size of the viewport they are drawn to.
+    void SetViewportSize(int width, int height)
+    {
+        glm::vec2 size(static_cast<float>(width), static_cast<float>(height));
+        m_dirty = m_dirty || size != m_viewportSize;
+        m_viewportSize = size;
+    }
+
     ColorMode GetColorMode() const
     {
         return m_colorMode;
     }
 
+    // The face colors are decoded on the GPU, so switching modes is free.
     void SetColorMode(ColorMode mode)
     {
+        m_dirty = m_dirty || mode != m_colorMode;
         m_colorMode = mode;
-        if (m_modelData) {
-            UpdateColorData();
-        }
     }
 
 private:
     void SetupShaders();
     void UpdateBuffers(ModelData const& modelData);
-    void SetupPickingFramebuffer();
-    void RenderWireframe(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
-    void RenderPoints(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
-    void RenderForPicking(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix);
-    void AddFaceVertices(Face const& face, std::vector<Vertex> const& vertices, int faceIndex);
-    void AddVertexColors(float r, float g, float b);
+    void BuildVertexData(ModelData const& modelData);
+    void BuildDrawOrder(ModelData const& modelData);
+    void WriteDrawFace(uint32_t slot, uint32_t face);
+    void SetupPaletteTextures();
+    void AddFaceData(Face const& face);
     void UploadVertexData();
-    void UpdateColorData();
+
+    struct GeomUniforms {
+        ShaderUniform<int> highlightFace;
+        ShaderUniform<int> selectedFace;
+        ShaderUniform<int> highlightVertex;
+        ShaderUniform<int> selectedVertex;
+        ShaderUniform<glm::vec4> highlightColor;
+        ShaderUniform<glm::vec4> selectedColor;
+        ShaderUniform<int> vertexMode;
+        ShaderUniform<int> wireframe;
+        ShaderUniform<glm::vec4> wireframeColor;
+        ShaderUniform<float> wireframeWidth;
+        ShaderUniform<float> vertexSize;
+        ShaderUniform<glm::vec2> viewportSize;
+        ShaderUniform<int> colorMode;
+        ShaderUniform<int> firstPrimitive;
+    };
 
     ShaderProgram m_shaderProgram;
-    ShaderProgram m_pickingShaderProgram;
+    GeomUniforms m_uniforms;
     uint32_t m_vao { 0 };
     VertexBuffer m_vertexVBO;
-    VertexBuffer m_colorVBO;
     IndexBuffer m_elementBuffer;
-    std::vector<float> m_vertexData;
-    std::vector<float> m_colorData;
-    std::vector<uint32_t> m_indices;
+    TextureBuffer m_faceBuffer;
+    TextureBuffer m_faceOrderBuffer;
+    UploadRing m_uploadRing;
+    uint32_t m_hslPaletteTexture { 0 };
+    uint32_t m_helperPaletteTexture { 0 };
+    // One entry per model vertex, shared by every face that uses it, so
+    // gl_VertexID is the model's vertex index.
+    std::vector<ModelVertex> m_vertexData;
+    std::vector<uint16_t> m_faceData;
+    // In face order. What is uploaded is the same in draw order: opaque
+    // faces by priority, then translucent faces back to front, with
+    // m_drawFaces mapping each drawn primitive back to its face.
+    std::vector<uint16_t> m_indices;
+    std::vector<uint16_t> m_drawIndices;
+    std::vector<uint32_t> m_drawFaces;
+    uint32_t m_opaqueFaceCount { 0 };
+    // Translucent faces by priority, with their centroids, and the scratch
+    // space for sorting them so a sort does not allocate.
+    std::vector<uint32_t> m_translucentFaces;
+    std::vector<glm::vec3> m_translucentCentroids;
+    std::vector<uint64_t> m_sortItems;
+    std::vector<uint64_t> m_sortScratch;
+    glm::mat4 m_sortedViewMatrix { 0.0f };
+    bool m_translucentSorted { false };
     int32_t m_vertexCount { 0 };
     int32_t m_faceCount { 0 };
     std::shared_ptr<ModelData> m_modelData;
+    ModelBVH m_bvh;
     glm::vec4 m_highlightColor { 1.0f, 0.8f, 0.2f, 1.0f };
     glm::vec4 m_selectedColor { 0.2f, 0.8f, 1.0f, 1.0f };
     glm::vec4 m_wireframeColor { 0.0f, 0.0f, 0.0f, 1.0f };
+    float m_wireframeWidth { 1.0f };
+    float m_vertexSize { 5.0f };
+    glm::vec2 m_viewportSize { 1.0f };
     int32_t m_hoveredFace { -1 };
     int32_t m_selectedFace { -1 };
     int32_t m_hoveredVertex { -1 };
     int32_t m_selectedVertex { -1 };
-    uint32_t m_pickingFBO { 0 };
-    uint32_t m_pickingTexture { 0 };
-    uint32_t m_pickingDepthRBO { 0 };
-    int32_t m_viewportWidth { 1 };
-    int32_t m_viewportHeight { 1 };
     ColorMode m_colorMode { ColorMode::Diffuse };
     bool m_wireframeMode { false };
     bool m_vertexMode { false };
+    bool m_dirty { true };
 };
 }
@@ -3,6 +3,7 @@
 #include "Dialogs.h"
 #include "Model.h"
 #include "ModelLoader.h"
+#include "ModelRecolor.h"
 #include "ModelViewer.h"
 
 #include "Packet.h"
@@ -20,6 +21,14 @@
 #include "UI.h"
 
 namespace imp {
+// Frames drawn after the last input before the viewer goes idle.
+constexpr int kActiveFrameCount = 3;
+// How long an idle viewer sleeps between checks on the file watcher.
+constexpr double kIdleWaitTimeout = 0.25;
+// Same, while exports or a reload are running.
+constexpr double kBusyWaitTimeout = 1.0 / 30.0;
+constexpr float kMaxFrameDelta = 1.0f / 30.0f;
+
 ModelViewer::ModelViewer()
     : m_settingsPath(std::filesystem::current_path() / "modelviewer_settings.json")
 {
@@ -39,6 +48,8 @@ ModelViewer::ModelViewer()
     modelRenderer.SetHighlightColor(m_settings.hoveredHighlightColor);
     modelRenderer.SetSelectedColor(m_settings.selectedHighlightColor);
     modelRenderer.SetWireframeColor(m_settings.wireframeColor);
+    modelRenderer.SetWireframeWidth(m_settings.wireframeWidth);
+    modelRenderer.SetVertexSize(m_settings.vertexSize);
     modelRenderer.SetVertexMode(m_settings.vertexMode);
 }
 
@@ -57,6 +68,7 @@ ModelViewer::~ModelViewer()
 void ModelViewer::Start()
 {
     m_renderer.Initialize();
+    m_activeFrames = kActiveFrameCount;
 
     float currentFrameTime;
     float deltaTime;
@@ -64,21 +76,54 @@ void ModelViewer::Start()
     while (glfwWindowShouldClose(m_window) == GLFW_FALSE && m_appRunning) {
         currentFrameTime = static_cast<float>(glfwGetTime());
         deltaTime = currentFrameTime - m_lastFrameTime;
-        m_deltaTime = deltaTime;
+        // Time spent waiting for events is not frame time, and would turn
+        // the first scroll after a pause into a huge zoom.
+        m_deltaTime = std::min(deltaTime, kMaxFrameDelta);
         m_lastFrameTime = currentFrameTime;
 
-        glfwPollEvents();
+        WaitForEvents();
         Logic(deltaTime);
+        if (!NeedsRedraw()) {
+            continue;
+        }
         Draw(deltaTime);
         glfwSwapBuffers(m_window);
+        if (m_activeFrames > 0) {
+            --m_activeFrames;
+        }
     }
 }
 
+void ModelViewer::WaitForEvents()
+{
+    if (m_activeFrames > 0) {
+        glfwPollEvents();
+    } else {
+        // Background work is checked on more often than an idle window.
+        bool busy = !m_exports.empty() || m_reloadFuture.valid();
+        glfwWaitEventsTimeout(busy ? kBusyWaitTimeout : kIdleWaitTimeout);
+    }
+
+    // Any input goes through ImGui's queue, even when it ends up moving the
+    // camera. A few frames are drawn after it so hover states and windows
+    // that size themselves over several frames settle.
+    if (ImGui::GetCurrentContext()->InputEventsQueue.Size > 0) {
+        m_activeFrames = kActiveFrameCount;
+    }
+}
+
+bool ModelViewer::NeedsRedraw() const
+{
+    return m_activeFrames > 0 || m_renderer.IsDirty() || !m_exports.empty();
+}
+
 void ModelViewer::Logic(float deltaTime)
 {
     if (m_settingsModified) {
         SaveSettings();
     }
+    UpdateExports();
+    UpdateHotReload();
 }
 
 void ModelViewer::Draw(float deltaTime)
@@ -92,6 +137,7 @@ void ModelViewer::Draw(float deltaTime)
     RenderModelViewer();
     RenderOptionsPanel();
     RenderModelStatsPanel();
+    RenderExportProgress();
     HandleShortcuts();
     ImGui_FrameEnd();
 }
@@ -177,6 +223,7 @@ void ModelViewer::InitGLFW()
     glfwSetMouseButtonCallback(m_window, MouseButtonCallback);
     glfwSetCursorPosCallback(m_window, CursorPosCallback);
     glfwSetScrollCallback(m_window, ScrollCallback);
+    glfwSetWindowRefreshCallback(m_window, WindowRefreshCallback);
 
     glEnable(GL_DEPTH_TEST);
 }
@@ -257,6 +304,9 @@ void ModelViewer::RenderMenuBar()
             if (ImGui::MenuItem("Export to DAT", nullptr, false, m_renderer.HasModelLoaded())) {
                 ExportModel(ExportFormat::DAT);
             }
+            if (ImGui::MenuItem("Export to GLB", nullptr, false, m_renderer.HasModelLoaded())) {
+                ExportModel(ExportFormat::GLB);
+            }
             ImGui::Separator();
             if (ImGui::MenuItem("Exit", "Alt+F4")) {
                 m_appRunning = false;
@@ -336,6 +386,24 @@ void ModelViewer::RenderModelViewer()
             m_renderer.GetModelRenderer().SetColorMode(ColorMode::Label);
         }
 
+        rightButtonPos.y += buttonSize + padding;
+        ImGui::SetCursorScreenPos(rightButtonPos);
+        if (UI::OverlayButton("T", currentMode == ColorMode::Trans, "Transparency Color Mode (4)", ImVec2(buttonSize, buttonSize))) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Trans);
+        }
+
+        rightButtonPos.y += buttonSize + padding;
+        ImGui::SetCursorScreenPos(rightButtonPos);
+        if (UI::OverlayButton("M", currentMode == ColorMode::Material, "Material Color Mode (5)", ImVec2(buttonSize, buttonSize))) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Material);
+        }
+
+        rightButtonPos.y += buttonSize + padding;
+        ImGui::SetCursorScreenPos(rightButtonPos);
+        if (UI::OverlayButton("U", currentMode == ColorMode::Mapping, "Texture Mapping Color Mode (6)", ImVec2(buttonSize, buttonSize))) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Mapping);
+        }
+
         constexpr float gizmoSize = 60.0f;
         ImVec2 gizmoPos {
             imagePos.x + padding,
@@ -506,6 +574,16 @@ void ModelViewer::RenderOptionsPanel()
                 m_settingsModified = true;
             }
 
+            if (UI::SliderFloat("Wireframe Width", &m_settings.wireframeWidth, 0.5f, 5.0f, "%.1f px")) {
+                m_renderer.GetModelRenderer().SetWireframeWidth(m_settings.wireframeWidth);
+                m_settingsModified = true;
+            }
+
+            if (UI::SliderFloat("Vertex Size", &m_settings.vertexSize, 1.0f, 15.0f, "%.1f px")) {
+                m_renderer.GetModelRenderer().SetVertexSize(m_settings.vertexSize);
+                m_settingsModified = true;
+            }
+
             if (UI::SliderInt("Tile Grid Size", &m_settings.tileGridSize, 0, 10)) {
                 m_renderer.SetTileGridSize(m_settings.tileGridSize);
                 m_settingsModified = true;
@@ -538,6 +616,21 @@ void ModelViewer::RenderOptionsPanel()
             }
         }
 
+        if (ImGui::CollapsingHeader("Recolor")) {
+            ImGui::TextWrapped("Find=replace pairs, applied in order.");
+            ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+            bool changed = ImGui::InputTextWithHint("##recolor", "Colors, e.g. 6798=127, 8741=960", m_recolorBuffer, sizeof(m_recolorBuffer));
+            ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+            changed |= ImGui::InputTextWithHint("##retexture", "Materials, e.g. 40=52", m_retextureBuffer, sizeof(m_retextureBuffer));
+            if (!m_recolorError.empty()) {
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", m_recolorError.c_str());
+            }
+
+            if (changed && m_sourceModel) {
+                m_renderer.GetModelRenderer().UpdateFaceData(RecolorModel(m_sourceModel));
+            }
+        }
+
         if (ImGui::CollapsingHeader("Face Tooltip")) {
             if (UI::Checkbox("Enabled", &m_settings.faceTooltip)) {
                 m_settingsModified = true;
@@ -653,6 +746,12 @@ void ModelViewer::HandleShortcuts()
             m_renderer.GetModelRenderer().SetColorMode(ColorMode::Priority);
         } else if (ImGui::IsKeyPressed(ImGuiKey_3, false)) {
             m_renderer.GetModelRenderer().SetColorMode(ColorMode::Label);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_4, false)) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Trans);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_5, false)) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Material);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_6, false)) {
+            m_renderer.GetModelRenderer().SetColorMode(ColorMode::Mapping);
         }
         if (ImGui::IsKeyPressed(ImGuiKey_W, false)) {
             m_settings.wireframeMode = !m_settings.wireframeMode;
@@ -730,14 +829,22 @@ void ModelViewer::ShowError(std::string const& title, std::string const& message
 
 void ModelViewer::LoadModel(std::filesystem::path const& path)
 {
+    // A pending reload must not land on top of the model loaded here.
+    if (m_reloadFuture.valid()) {
+        m_reloadFuture.wait();
+        m_reloadFuture = {};
+    }
+
     std::shared_ptr<ModelData> model = std::make_shared<ModelData>();
     if (!ModelLoader::LoadFromFile(*model, path)) {
         return;
     }
 
-    m_renderer.GetModelRenderer().SetModelData(model);
+    m_sourceModel = model;
+    m_renderer.GetModelRenderer().SetModelData(RecolorModel(model));
 
     m_currentLoadedModelPath = path;
+    m_fileWatcher.Watch(path);
 
     int16_t maxX = std::numeric_limits<int16_t>::min();
     int16_t maxY = std::numeric_limits<int16_t>::min();
@@ -782,6 +889,8 @@ void ModelViewer::LoadSettings()
         m_settings.windowPosY = j.value("windowPosY", 100);
 
         m_settings.vertexMode = j.value("vertexMode", false);
+        m_settings.wireframeWidth = j.value("wireframeWidth", 1.0f);
+        m_settings.vertexSize = j.value("vertexSize", 5.0f);
 
         m_settings.faceTooltip = j.value("faceTooltip", true);
         if (j.contains("faceTooltipOptions")) {
@@ -867,6 +976,8 @@ void ModelViewer::SaveSettings()
         j["windowPosX"] = posX;
         j["windowPosY"] = posY;
         j["vertexMode"] = m_settings.vertexMode;
+        j["wireframeWidth"] = m_settings.wireframeWidth;
+        j["vertexSize"] = m_settings.vertexSize;
         j["faceTooltip"] = m_settings.faceTooltip;
 
         nlohmann::json faceTooltipOpts;
@@ -959,6 +1070,13 @@ void ModelViewer::CursorPosCallback(GLFWwindow* window, double xpos, double ypos
     viewer->m_prevMousePos = { static_cast<float>(xpos), static_cast<float>(ypos) };
 }
 
+void ModelViewer::WindowRefreshCallback(GLFWwindow* window)
+{
+    // Resizing and uncovering the window do not go through ImGui's queue.
+    auto* viewer = static_cast<ModelViewer*>(glfwGetWindowUserPointer(window));
+    viewer->m_activeFrames = kActiveFrameCount;
+}
+
 void ModelViewer::ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
     auto* viewer = static_cast<ModelViewer*>(glfwGetWindowUserPointer(window));
@@ -967,6 +1085,46 @@ void ModelViewer::ScrollCallback(GLFWwindow* window, double xoffset, double yoff
     }
 }
 
+void ModelViewer::RenderExportProgress()
+{
+    if (m_exports.empty()) {
+        return;
+    }
+
+    constexpr float kPadding = 10.0f;
+    ImGuiViewport const* viewport = ImGui::GetMainViewport();
+    ImVec2 position(viewport->WorkPos.x + viewport->WorkSize.x - kPadding, viewport->WorkPos.y + viewport->WorkSize.y - kPadding);
+    ImGui::SetNextWindowPos(position, ImGuiCond_Always, ImVec2(1.0f, 1.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings
+        | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoDocking;
+    if (ImGui::Begin("##ExportProgress", nullptr, flags)) {
+        for (ExportStatus const& status : m_exports) {
+            ExportJob const& job = *status.job;
+            std::string fileName = job.path.filename().string();
+            ImGui::TextUnformatted(fileName.c_str());
+
+            char const* overlay = nullptr;
+            switch (job.state.load(std::memory_order_acquire)) {
+            case ExportJobState::Queued:
+                overlay = "Queued";
+                break;
+            case ExportJobState::Running:
+                break;
+            case ExportJobState::Succeeded:
+                overlay = "Done";
+                break;
+            case ExportJobState::Failed:
+                overlay = "Failed";
+                break;
+            }
+            ImGui::ProgressBar(job.progress.load(std::memory_order_relaxed), ImVec2(250.0f, 0.0f), overlay);
+        }
+    }
+    ImGui::End();
+}
+
 void ModelViewer::RenderModelStatsPanel()
 {
     if (UI::BeginPanel("Model", nullptr, ImGuiWindowFlags_None)) {
@@ -1253,34 +1411,96 @@ void ModelViewer::ExportModel(ExportFormat format)
     std::shared_ptr<ModelData> modelData = m_renderer.GetModelData();
 
     std::vector<std::pair<std::string, std::string>> filters;
-    char const* extension;
+    char const* title;
     if (format == ExportFormat::MQO) {
         filters.push_back({ "Metasequoia Files", "*.mqo" });
-        extension = ".mqo";
+        title = "Save MQO File";
+    } else if (format == ExportFormat::GLB) {
+        filters.push_back({ "Binary glTF Files", "*.glb" });
+        title = "Save GLB File";
     } else {
         filters.push_back({ "DAT Files", "*.dat" });
-        extension = ".dat";
+        title = "Save DAT File";
     }
-    std::optional<std::filesystem::path> savePath = SaveFileDialog("Save MQO File", "", filters);
+    std::optional<std::filesystem::path> savePath = SaveFileDialog(title, "", filters);
     if (!savePath.has_value()) {
         return;
     }
 
     std::filesystem::path& path = *savePath;
+    char const* extension = ModelExporter::GetExtension(format);
     if (path.extension() != extension) {
         path.replace_extension(extension);
     }
 
-    bool success;
-    if (format == ExportFormat::DAT) {
-        success = ModelExporter::ExportV1(*modelData, path);
-    } else {
-        success = ModelExporter::ExportMQO(*modelData, path);
+    m_exports.push_back({ m_exportQueue.Enqueue(*modelData, path, format) });
+}
+
+void ModelViewer::UpdateExports()
+{
+    // Finished entries linger for a moment so the user can see the result.
+    constexpr float kFinishedDisplayTime = 3.0f;
+
+    for (ExportStatus& status : m_exports) {
+        if (status.finishedTime >= 0.0f || !status.job->IsFinished()) {
+            continue;
+        }
+        status.finishedTime = m_lastFrameTime;
+        if (status.job->state.load(std::memory_order_acquire) == ExportJobState::Failed) {
+            ShowError("Export Failed", "Failed to export the model to " + status.job->path.string());
+        }
     }
-    if (success) {
-        UI::ShowAlert("Export Successful", "Model has been exported to " + path.string(), AlertType::Info);
-    } else {
-        ShowError("Export Failed", "Failed to export the model to " + path.string());
+
+    std::erase_if(m_exports, [this](ExportStatus const& status) {
+        return status.finishedTime >= 0.0f && m_lastFrameTime - status.finishedTime > kFinishedDisplayTime;
+    });
+}
+
+std::shared_ptr<ModelData> ModelViewer::RecolorModel(std::shared_ptr<ModelData> const& model)
+{
+    RecolorDefinition definition;
+    m_recolorError.clear();
+    if (!RecolorDefinition::ParseColors(m_recolorBuffer, definition, m_recolorError)
+        || !RecolorDefinition::ParseMaterials(m_retextureBuffer, definition, m_recolorError)
+        || definition.IsEmpty()) {
+        return model;
+    }
+
+    std::shared_ptr<ModelData> recolored = std::make_shared<ModelData>(*model);
+    ModelRecolor(definition).Apply(*recolored);
+    return recolored;
+}
+
+void ModelViewer::UpdateHotReload()
+{
+    if (m_reloadFuture.valid()) {
+        if (m_reloadFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        std::shared_ptr<ModelData> model = m_reloadFuture.get();
+        if (model) {
+            m_sourceModel = model;
+            m_renderer.GetModelRenderer().UpdateModelData(RecolorModel(model));
+        }
+        return;
     }
+
+    if (!m_fileWatcher.ConsumeChange()) {
+        return;
+    }
+
+    // Parse on a worker so a large model does not stall the UI. Failures are
+    // only logged, the file is often mid-save and another change will follow.
+    // It is read into memory rather than mapped, as the editor may truncate
+    // it while it is being parsed.
+    m_reloadFuture = std::async(std::launch::async, [path = m_currentLoadedModelPath]() -> std::shared_ptr<ModelData> {
+        std::shared_ptr<ModelData> model = std::make_shared<ModelData>();
+        std::string errorMessage;
+        if (!ModelLoader::LoadFromFile(*model, path, errorMessage, FileAccess::Buffered)) {
+            IMP_LOG_WARN("Failed to reload %s: %s", path.string().c_str(), errorMessage.c_str());
+            return nullptr;
+        }
+        return model;
+    });
 }
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "ExportQueue.h"
 #include "FileExplorer.h"
+#include "FileWatcher.h"
+#include "ModelExporter.h"
 #include "Renderer.h"
 
 #include <filesystem>
@@ -13,11 +16,6 @@
 #include "imgui.h"
 
 namespace imp {
-enum class ExportFormat {
-    MQO,
-    DAT
-};
-
 struct ApplicationSettings {
     bool wireframeMode { true };
     int tileGridSize { 1 };
@@ -45,11 +43,18 @@ struct ApplicationSettings {
     glm::vec4 hoveredHighlightColor { 1.0f, 0.8f, 0.2f, 1.0f };
     glm::vec4 selectedHighlightColor { 0.2f, 0.8f, 1.0f, 1.0f };
     glm::vec4 wireframeColor { 0.0f, 0.0f, 0.0f, 1.0f };
+    float wireframeWidth { 1.0f };
+    float vertexSize { 5.0f };
     int uiTheme { 0 };
     float uiScale { 1.0f };
     bool vertexMode { false };
 };
 
+struct ExportStatus {
+    std::shared_ptr<ExportJob> job;
+    float finishedTime { -1.0f };
+};
+
 class ModelViewer {
 public:
     ModelViewer();
@@ -60,6 +65,8 @@ public:
     friend class FileExplorer;
 
 private:
+    void WaitForEvents();
+    bool NeedsRedraw() const;
     void Logic(float deltaTime);
     void Draw(float deltaTime);
     void DrawPick();
@@ -77,6 +84,7 @@ private:
     void RenderVertexTooltip();
     void RenderOptionsPanel();
     void RenderModelStatsPanel();
+    void RenderExportProgress();
     void RenderFaceDetails(char const* label, int faceIndex, Face const& face, std::vector<Vertex> const& vertices);
     void RenderVertexDetails(char const* label, int vertexIndex, Vertex const& vertex);
     void HandleShortcuts();
@@ -90,6 +98,9 @@ private:
 
     void LoadModel(std::filesystem::path const& path);
     void ExportModel(ExportFormat format);
+    void UpdateExports();
+    void UpdateHotReload();
+    std::shared_ptr<ModelData> RecolorModel(std::shared_ptr<ModelData> const& model);
 
     void LoadSettings();
     void SaveSettings();
@@ -97,10 +108,13 @@ private:
     static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
     static void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
     static void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+    static void WindowRefreshCallback(GLFWwindow* window);
     GLFWwindow* m_window;
     bool m_appRunning { true };
     float m_lastFrameTime { 0.0f };
     float m_deltaTime { 0.0f };
+    // Counts down the frames still to draw before waiting for events.
+    int m_activeFrames { 0 };
 
     bool m_leftMousePressed { false };
     bool m_middleMousePressed { false };
@@ -121,6 +135,18 @@ private:
     std::filesystem::path m_settingsPath;
     std::future<void> m_scanFuture;
 
+    FileWatcher m_fileWatcher;
+    std::future<std::shared_ptr<ModelData>> m_reloadFuture;
+
+    // The model as loaded; what is on screen is this with the recolor applied.
+    std::shared_ptr<ModelData> m_sourceModel;
+    char m_recolorBuffer[1024] {};
+    char m_retextureBuffer[1024] {};
+    std::string m_recolorError;
+
+    ExportQueue m_exportQueue;
+    std::vector<ExportStatus> m_exports;
+
     ApplicationSettings m_settings;
     bool m_settingsModified { false };
 
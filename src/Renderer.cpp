@@ -15,6 +15,8 @@ namespace imp {
 constexpr float kDefaultCameraDistance = 500.0f;
 constexpr float kDefaultCameraPhi = 0.75f;
 constexpr float kDefaultCameraTheta = 1.2f;
+// tile size is 128 in low revision or 512 in high revision
+constexpr float kTileSize = 128.0f;
 
 Renderer::Renderer()
     : m_planeVAO(0)
@@ -120,19 +122,29 @@ void Renderer::Destroy()
         glDeleteRenderbuffers(1, &m_renderBuffer);
         m_renderBuffer = 0;
     }
+    m_cameraBuffer.Destroy();
 }
 
 void Renderer::SetupShaders()
 {
     m_gridShaderProgram.Create(gridVertexShaderSource, gridFragmentShaderSource);
+    m_gridShaderProgram.BindUniformBlock("Camera", kCameraUniformBinding);
+    m_gridUniforms.cameraPosition = m_gridShaderProgram.GetUniform<glm::vec3>("uCameraPosition");
+    m_gridUniforms.gridSize = m_gridShaderProgram.GetUniform<float>("uGridSize");
+    m_gridUniforms.farPlane = m_gridShaderProgram.GetUniform<float>("uFarPlane");
+    m_gridUniforms.cameraZoom = m_gridShaderProgram.GetUniform<float>("uCameraZoom");
+
     m_tileShaderProgram.Create(tileVertexShaderSource, tileFragmentShaderSource);
+    m_tileShaderProgram.BindUniformBlock("Camera", kCameraUniformBinding);
+    m_tileUniforms.tileGridSize = m_tileShaderProgram.GetUniform<int>("uTileGridSize");
+    m_tileUniforms.tileSize = m_tileShaderProgram.GetUniform<float>("uTileSize");
+
+    m_cameraBuffer.Create(sizeof(CameraBlock), BUFFER_FLAG_DYNAMIC, nullptr);
 }
 
 void Renderer::SetupTileGridPlane()
 {
-    // tile size is 128 in low revision or 512 in high revision
-    constexpr float planeSize = 128.0f;
-    constexpr float halfSize = planeSize / 2.0f;
+    constexpr float halfSize = kTileSize / 2.0f;
 
     m_planeVertices = {
         -halfSize, 0.0f, -halfSize, 0.0f, 0.0f,
@@ -201,6 +213,8 @@ void Renderer::SetViewportSize(int width, int height)
 
     m_viewportWidth = width;
     m_viewportHeight = height;
+    m_dirty = true;
+    m_modelRenderer.SetViewportSize(width, height);
     m_aspectRatio = static_cast<float>(width) / static_cast<float>(height);
     UpdateProjectionMatrix();
 
@@ -228,17 +242,26 @@ void Renderer::SetViewportSize(int width, int height)
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    m_modelRenderer.SetViewportSize(width, height);
 }
 
 void Renderer::Render(float deltaTime)
 {
     (void)deltaTime;
 
+    // The background follows the UI theme, so a theme change is a change too.
+    ImVec4 const& windowColor = ImGui::GetStyle().Colors[ImGuiCol_WindowBg];
+    glm::vec4 color(windowColor.x, windowColor.y, windowColor.z, windowColor.w);
+    if (color != m_clearColor) {
+        m_clearColor = color;
+        m_dirty = true;
+    }
+    if (!IsDirty()) {
+        return;
+    }
+    m_dirty = false;
+
     glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
 
-    ImVec4 const& color = ImGui::GetStyle().Colors[ImGuiCol_WindowBg];
     glClearColor(color.x, color.y, color.z, color.w);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -257,10 +280,16 @@ void Renderer::Render(float deltaTime)
 
     m_viewMatrix = glm::lookAt(m_cameraPosition, m_cameraTarget, m_cameraUp);
 
+    // Every program reads the matrices from here.
+    CameraBlock camera { m_viewMatrix, m_projectionMatrix };
+    m_cameraBuffer.Update(0, sizeof(camera), &camera);
+    m_cameraBuffer.BindBase(kCameraUniformBinding);
+
     DrawInfiniteGrid();
     DrawTileGrid();
 
-    m_modelRenderer.Render(m_viewMatrix, m_projectionMatrix);
+    m_modelRenderer.SortTranslucentFaces(m_viewMatrix);
+    m_modelRenderer.Render();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -274,26 +303,11 @@ void Renderer::DrawTileGrid()
     glDisable(GL_CULL_FACE);
     m_tileShaderProgram.Bind();
 
-    m_tileShaderProgram.SetUniform("uViewMatrix", m_viewMatrix);
-    m_tileShaderProgram.SetUniform("uProjectionMatrix", m_projectionMatrix);
+    m_tileUniforms.tileGridSize.Set(m_tileGridSize);
+    m_tileUniforms.tileSize.Set(kTileSize);
 
     glBindVertexArray(m_planeVAO);
-    float gridWidth = static_cast<float>(m_tileGridSize) * 128.0f;
-    float gridHeight = static_cast<float>(m_tileGridSize) * 128.0f;
-    float centerX = gridWidth / 2.0f;
-    float centerZ = gridHeight / 2.0f;
-
-    for (int i = 0; i < m_tileGridSize * m_tileGridSize; ++i) {
-        int row = i / m_tileGridSize;
-        int col = i % m_tileGridSize;
-
-        float xOffset = (static_cast<float>(col) * 128.0f) + 64.0f;
-        float zOffset = (static_cast<float>(row) * 128.0f) + 64.0f;
-
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(xOffset - centerX, 0.0f, zOffset - centerZ));
-        m_tileShaderProgram.SetUniform("uModelMatrix", model);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_planeIndices.size()), GL_UNSIGNED_INT, nullptr);
-    }
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_planeIndices.size()), GL_UNSIGNED_INT, nullptr, m_tileGridSize * m_tileGridSize);
     glBindVertexArray(0);
     glEnable(GL_CULL_FACE);
 }
@@ -306,12 +320,10 @@ void Renderer::DrawInfiniteGrid()
     glDisable(GL_CULL_FACE);
 
     m_gridShaderProgram.Bind();
-    m_gridShaderProgram.SetUniform("uViewMatrix", m_viewMatrix);
-    m_gridShaderProgram.SetUniform("uProjectionMatrix", m_projectionMatrix);
-    m_gridShaderProgram.SetUniform("uCameraPosition", m_cameraPosition);
-    m_gridShaderProgram.SetUniform("uGridSize", m_gridSize);
-    m_gridShaderProgram.SetUniform("uFarPlane", m_farPlane);
-    m_gridShaderProgram.SetUniform("uCameraZoom", m_cameraDistance);
+    m_gridUniforms.cameraPosition.Set(m_cameraPosition);
+    m_gridUniforms.gridSize.Set(m_gridSize);
+    m_gridUniforms.farPlane.Set(m_farPlane);
+    m_gridUniforms.cameraZoom.Set(m_cameraDistance);
 
     glBindVertexArray(m_gridVAO);
     glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
@@ -331,6 +343,7 @@ void Renderer::SetCameraPosition(glm::vec3 const& position)
 {
     m_cameraPosition = position;
     m_viewMatrix = glm::lookAt(m_cameraPosition, m_cameraTarget, m_cameraUp);
+    m_dirty = true;
 }
 
 void Renderer::OrbitCamera(float deltaX, float deltaY)
@@ -338,6 +351,7 @@ void Renderer::OrbitCamera(float deltaX, float deltaY)
     m_cameraPhi += deltaX * 0.01f;
     m_cameraTheta += deltaY * 0.01f;
     m_cameraTheta = glm::clamp(m_cameraTheta, 0.1f, 3.0f);
+    m_dirty = true;
 }
 
 void Renderer::PanCamera(float deltaX, float deltaY)
@@ -349,12 +363,14 @@ void Renderer::PanCamera(float deltaX, float deltaY)
     float panSpeed = m_cameraDistance * 0.002f;
 
     m_cameraTarget += (-right * deltaX * panSpeed) + (up * -deltaY * panSpeed);
+    m_dirty = true;
 }
 
 void Renderer::ZoomCamera(float amount)
 {
     m_cameraDistance += amount;
     m_cameraDistance = glm::clamp(m_cameraDistance, 1.0f, 1000.0f);
+    m_dirty = true;
 }
 
 void Renderer::ResetCamera()
@@ -394,5 +410,6 @@ void Renderer::SetFarPlane(float farPlane)
 void Renderer::UpdateProjectionMatrix()
 {
     m_projectionMatrix = glm::perspective(glm::radians(m_fov), m_aspectRatio, m_nearPlane, m_farPlane);
+    m_dirty = true;
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ModelRenderer.h"
+#include "render/UniformBuffer.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,6 +9,9 @@
 #include <vector>
 
 namespace imp {
+// Binding point of the Camera uniform block every program declares.
+constexpr uint32_t kCameraUniformBinding = 0;
+
 class Renderer {
 public:
     Renderer();
@@ -16,8 +20,20 @@ public:
     void Initialize();
     void Destroy();
 
+    // Redraws the scene texture, or does nothing if nothing shown in it has
+    // changed since the last call.
     void Render(float deltaTime);
 
+    bool IsDirty() const
+    {
+        return m_dirty || m_modelRenderer.IsDirty();
+    }
+
+    void Invalidate()
+    {
+        m_dirty = true;
+    }
+
     void SetCameraPosition(glm::vec3 const& position);
     void OrbitCamera(float deltaX, float deltaY);
     void PanCamera(float deltaX, float deltaY);
@@ -49,6 +65,7 @@ public:
 
     void SetTileGridSize(int size)
     {
+        m_dirty = m_dirty || size != m_tileGridSize;
         m_tileGridSize = size;
     }
 
@@ -56,6 +73,7 @@ public:
     {
         m_cameraTarget = target;
         m_viewMatrix = glm::lookAt(m_cameraPosition, m_cameraTarget, m_cameraUp);
+        m_dirty = true;
     }
 
     std::shared_ptr<ModelData> const& GetModelData() const
@@ -82,8 +100,29 @@ private:
     void DrawInfiniteGrid();
     void UpdateProjectionMatrix();
 
+    // std140 layout of the Camera block.
+    struct CameraBlock {
+        glm::mat4 viewMatrix;
+        glm::mat4 projectionMatrix;
+    };
+
+    struct GridUniforms {
+        ShaderUniform<glm::vec3> cameraPosition;
+        ShaderUniform<float> gridSize;
+        ShaderUniform<float> farPlane;
+        ShaderUniform<float> cameraZoom;
+    };
+
+    struct TileUniforms {
+        ShaderUniform<int> tileGridSize;
+        ShaderUniform<float> tileSize;
+    };
+
     ShaderProgram m_tileShaderProgram;
     ShaderProgram m_gridShaderProgram;
+    GridUniforms m_gridUniforms;
+    TileUniforms m_tileUniforms;
+    UniformBuffer m_cameraBuffer;
     uint32_t m_planeVAO;
     uint32_t m_planeVBO;
     uint32_t m_planeEBO;
@@ -119,6 +158,11 @@ private:
     int m_viewportWidth;
     int m_viewportHeight;
 
+    // Set by anything that changes the picture; the scene texture is kept
+    // as-is until then.
+    bool m_dirty { true };
+    glm::vec4 m_clearColor { 0.0f };
+
     ModelRenderer m_modelRenderer;
 };
 
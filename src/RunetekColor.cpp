@@ -3,25 +3,29 @@
 #include "helperColors.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
-#include <cmath>
+#include <climits>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
 
-#include <iostream>
-#include <tuple>
-#include <unordered_map>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define IMP_COLOR_SSE2 1
+#    include <emmintrin.h>
+#endif
 
 namespace imp::math {
-uint32_t* RunetekColor::m_hslToRGB = nullptr;
 static std::once_flag initFlag;
-static std::unordered_map<uint32_t, uint16_t> exactMap;
-static std::unordered_map<uint32_t, uint16_t> cache;
 
-void RunetekColor::InitColorTables()
+// The palette is produced with the same float math as the client, but
+// evaluated by the compiler, so there is nothing to initialize at startup.
+static constexpr std::array<uint32_t, 0x10000> GenerateHSLToRGB()
 {
     constexpr float kOneThird = 1.0f / 3.0f;
     constexpr float kTwoThirds = 2.0f / 3.0f;
-    assert(!m_hslToRGB);
-    m_hslToRGB = new uint32_t[0x10000];
+    std::array<uint32_t, 0x10000> table {};
     for (uint32_t hsl = 0; hsl < 0x10000; hsl++) {
         float hue = (static_cast<float>(hsl >> 10) + 0.5f) / 64.0f;
         float sat = (static_cast<float>(hsl >> 7 & 0x7) + 0.5f) / 8.0f;
@@ -80,74 +84,323 @@ void RunetekColor::InitColorTables()
         int32_t unormRed = static_cast<int32_t>(red * 256.0f);
         int32_t unormGreen = static_cast<int32_t>(green * 256.0f);
         int32_t unormBlue = static_cast<int32_t>(blue * 256.0f);
-        m_hslToRGB[hsl] = unormRed << 16 | unormGreen << 8 | unormBlue;
+        table[hsl] = unormRed << 16 | unormGreen << 8 | unormBlue;
     }
+    return table;
 }
 
-void RunetekColor::DestroyColorTables()
+static constexpr std::array<uint32_t, std::size(s_helperColors)> GenerateHelperToRGB()
 {
-    if (m_hslToRGB) {
-        delete[] m_hslToRGB;
-        m_hslToRGB = nullptr;
+    std::array<uint32_t, std::size(s_helperColors)> table {};
+    for (size_t i = 0; i < table.size(); ++i) {
+        uint8_t r = static_cast<uint8_t>(s_helperColors[i][0] * 255.0f);
+        uint8_t g = static_cast<uint8_t>(s_helperColors[i][1] * 255.0f);
+        uint8_t b = static_cast<uint8_t>(s_helperColors[i][2] * 255.0f);
+        table[i] = (r << 16) | (g << 8) | b;
     }
+    return table;
 }
-uint16_t RunetekColor::RGBToHSL(uint32_t rgb)
+
+static constexpr std::array<uint32_t, 0x10000> kHSLToRGB = GenerateHSLToRGB();
+static constexpr std::array<uint32_t, std::size(s_helperColors)> kHelperToRGB = GenerateHelperToRGB();
+
+// Lock-free cache of nearest color searches. Every slot holds the RGB key, a
+// presence bit and the HSL result in one word, so a reader can never observe
+// a half written entry. When probing runs too long the result is simply not
+// cached, the table never needs to grow or be locked.
+constexpr uint32_t kCacheBits = 16;
+constexpr uint32_t kCacheMask = (1u << kCacheBits) - 1;
+constexpr uint32_t kMaxCacheProbes = 16;
+constexpr uint64_t kCachePresentBit = uint64_t { 1 } << 32;
+static std::atomic<uint64_t> cache[1 << kCacheBits];
+static std::atomic<uint64_t> cacheHits { 0 };
+static std::atomic<uint64_t> cacheMisses { 0 };
+
+// Open addressing table from a palette RGB value to the last HSL value that
+// produces it. Palette values fit in 24 bits, so the empty marker can never
+// be a key, and inputs with any of the top bits set are not looked up here.
+constexpr uint32_t kExactTableBits = 17;
+constexpr uint32_t kExactTableMask = (1u << kExactTableBits) - 1;
+constexpr uint32_t kEmptySlot = 0xffffffff;
+static std::vector<uint32_t> exactKeys;
+static std::vector<uint16_t> exactValues;
+
+// Uniform grid over RGB space for nearest color searches. The palette colors
+// of each cell are stored together in HSL order and padded to a multiple of
+// kCellLanes with entries that are never the nearest. Channels are kept as
+// int16 pairs (r, g) and (b, 0) so squared distances for a group of lanes
+// are two multiply-adds.
+constexpr int32_t kGridBits = 4;
+constexpr int32_t kGridSize = 1 << kGridBits;
+constexpr int32_t kCellWidth = 256 >> kGridBits;
+constexpr int32_t kCellCount = kGridSize * kGridSize * kGridSize;
+constexpr uint32_t kCellLanes = 4;
+constexpr int32_t kPaddingChannel = 0x4000;
+static std::vector<uint32_t> cellStart;
+static std::vector<uint32_t> cellRG;
+static std::vector<uint32_t> cellB;
+static std::vector<uint16_t> cellHSL;
+
+static uint32_t FindExactSlot(uint32_t rgb)
 {
-    std::call_once(initFlag, [&]() {
-        exactMap.reserve(65536);
-        for (uint32_t i = 0; i < 65536; ++i) {
-            exactMap[m_hslToRGB[i]] = i;
+    uint32_t slot = (rgb * 0x9e3779b1u) >> (32 - kExactTableBits);
+    while (exactKeys[slot] != kEmptySlot && exactKeys[slot] != rgb) {
+        slot = (slot + 1) & kExactTableMask;
+    }
+    return slot;
+}
+
+static uint32_t CacheSlot(uint32_t rgb)
+{
+    return (rgb * 0x85ebca6bu) >> (32 - kCacheBits);
+}
+
+static bool FindCached(uint32_t rgb, uint16_t& hsl)
+{
+    uint64_t key = rgb | kCachePresentBit;
+    uint32_t slot = CacheSlot(rgb);
+    for (uint32_t probe = 0; probe < kMaxCacheProbes; ++probe) {
+        uint64_t entry = cache[slot].load(std::memory_order_relaxed);
+        if (entry == 0) {
+            return false;
         }
-        cache.reserve(4096);
-    });
+        if (entry >> 16 == key) {
+            hsl = static_cast<uint16_t>(entry);
+            return true;
+        }
+        slot = (slot + 1) & kCacheMask;
+    }
+    return false;
+}
+
+static void StoreCached(uint32_t rgb, uint16_t hsl)
+{
+    uint64_t key = rgb | kCachePresentBit;
+    uint64_t entry = key << 16 | hsl;
+    uint32_t slot = CacheSlot(rgb);
+    for (uint32_t probe = 0; probe < kMaxCacheProbes; ++probe) {
+        uint64_t expected = 0;
+        if (cache[slot].compare_exchange_strong(expected, entry, std::memory_order_relaxed) || expected >> 16 == key) {
+            return;
+        }
+        slot = (slot + 1) & kCacheMask;
+    }
+}
+
+static int32_t CellIndex(int32_t r, int32_t g, int32_t b)
+{
+    return ((r / kCellWidth) * kGridSize + g / kCellWidth) * kGridSize + b / kCellWidth;
+}
+
+static uint32_t PackChannels(int32_t low, int32_t high)
+{
+    return static_cast<uint32_t>(low & 0xffff) | static_cast<uint32_t>(high & 0xffff) << 16;
+}
+
+static void BuildSearchTables(uint32_t const* hslToRGB)
+{
+    exactKeys.assign(kExactTableMask + 1, kEmptySlot);
+    exactValues.assign(kExactTableMask + 1, 0);
+    std::vector<uint16_t> firstValues(kExactTableMask + 1, 0);
+    std::vector<uint32_t> cellCounts(kCellCount, 0);
+    for (uint32_t hsl = 0; hsl < 0x10000; ++hsl) {
+        uint32_t rgb = hslToRGB[hsl];
+        uint32_t slot = FindExactSlot(rgb);
+        if (exactKeys[slot] == kEmptySlot) {
+            exactKeys[slot] = rgb;
+            firstValues[slot] = static_cast<uint16_t>(hsl);
+            cellCounts[CellIndex(rgb >> 16 & 0xff, rgb >> 8 & 0xff, rgb & 0xff)]++;
+        }
+        exactValues[slot] = static_cast<uint16_t>(hsl);
+    }
+
+    // A nearest search only runs for colors without an exact match and ties
+    // go to the lowest HSL value, so the grid only needs the first HSL value
+    // of every distinct RGB value.
+    cellStart.resize(kCellCount + 1);
+    uint32_t offset = 0;
+    for (int32_t cell = 0; cell < kCellCount; ++cell) {
+        cellStart[cell] = offset;
+        offset += (cellCounts[cell] + kCellLanes - 1) / kCellLanes * kCellLanes;
+    }
+    cellStart[kCellCount] = offset;
 
-    if (auto it = exactMap.find(rgb); it != exactMap.end()) {
-        return it->second;
+    cellRG.assign(offset, PackChannels(kPaddingChannel, kPaddingChannel));
+    cellB.assign(offset, PackChannels(kPaddingChannel, 0));
+    cellHSL.assign(offset, 0);
+    std::vector<uint32_t> cellFill(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t hsl = 0; hsl < 0x10000; ++hsl) {
+        uint32_t rgb = hslToRGB[hsl];
+        if (firstValues[FindExactSlot(rgb)] != hsl) {
+            continue;
+        }
+        int32_t r = rgb >> 16 & 0xff;
+        int32_t g = rgb >> 8 & 0xff;
+        int32_t b = rgb & 0xff;
+        uint32_t entry = cellFill[CellIndex(r, g, b)]++;
+        cellRG[entry] = PackChannels(r, g);
+        cellB[entry] = PackChannels(b, 0);
+        cellHSL[entry] = static_cast<uint16_t>(hsl);
     }
-    if (auto it = cache.find(rgb); it != cache.end()) {
-        return it->second;
+}
+
+static void ConsiderCandidate(int32_t distance, uint16_t hsl, int32_t& bestDistance, uint16_t& bestHSL)
+{
+    if (distance < bestDistance || (distance == bestDistance && hsl < bestHSL)) {
+        bestDistance = distance;
+        bestHSL = hsl;
     }
+}
 
-    uint32_t r0 = (rgb >> 16) & 0xff;
-    uint32_t g0 = (rgb >> 8) & 0xff;
-    uint32_t b0 = (rgb) & 0xff;
+static void ScanCell(int32_t cell, int32_t r, int32_t g, int32_t b, int32_t& bestDistance, uint16_t& bestHSL)
+{
+    uint32_t begin = cellStart[cell];
+    uint32_t end = cellStart[cell + 1];
+#if IMP_COLOR_SSE2
+    __m128i const queryRG = _mm_set1_epi32(static_cast<int32_t>(PackChannels(r, g)));
+    __m128i const queryB = _mm_set1_epi32(static_cast<int32_t>(PackChannels(b, 0)));
+    for (uint32_t i = begin; i < end; i += kCellLanes) {
+        __m128i deltaRG = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&cellRG[i])), queryRG);
+        __m128i deltaB = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&cellB[i])), queryB);
+        __m128i distance = _mm_add_epi32(_mm_madd_epi16(deltaRG, deltaRG), _mm_madd_epi16(deltaB, deltaB));
+        // Lanes that could beat or tie the best so far are settled one by one
+        // so ties keep going to the lowest HSL value.
+        __m128i threshold = _mm_set1_epi32(bestDistance == INT_MAX ? INT_MAX : bestDistance + 1);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(distance, threshold)));
+        if (mask == 0) {
+            continue;
+        }
+        alignas(16) int32_t distances[kCellLanes];
+        _mm_store_si128(reinterpret_cast<__m128i*>(distances), distance);
+        for (uint32_t lane = 0; lane < kCellLanes; ++lane) {
+            if (mask & (1 << lane)) {
+                ConsiderCandidate(distances[lane], cellHSL[i + lane], bestDistance, bestHSL);
+            }
+        }
+    }
+#else
+    for (uint32_t i = begin; i < end; ++i) {
+        int32_t dr = static_cast<int16_t>(cellRG[i] & 0xffff) - r;
+        int32_t dg = static_cast<int16_t>(cellRG[i] >> 16) - g;
+        int32_t db = static_cast<int16_t>(cellB[i] & 0xffff) - b;
+        ConsiderCandidate(dr * dr + dg * dg + db * db, cellHSL[i], bestDistance, bestHSL);
+    }
+#endif
+}
 
-    uint32_t bestDiff = std::numeric_limits<uint32_t>::max();
-    uint32_t bestIndex = 0;
+// Visits the grid in growing shells of cells around the query color until
+// no unvisited cell can hold anything as close as the best match found.
+static uint16_t FindNearestHSL(int32_t r, int32_t g, int32_t b)
+{
+    int32_t const query[3] = { r, g, b };
+    int32_t const center[3] = { r / kCellWidth, g / kCellWidth, b / kCellWidth };
+    int32_t bestDistance = INT_MAX;
+    uint16_t bestHSL = 0;
 
-    for (uint32_t i = 0; i < 65536; ++i) {
-        uint32_t color = m_hslToRGB[i];
-        uint32_t dr = r0 - (color >> 16 & 0xff);
-        uint32_t dg = g0 - (color >> 8 & 0xff);
-        uint32_t db = b0 - (color & 0xff);
+    for (int32_t ring = 0; ring < kGridSize; ++ring) {
+        int32_t low[3];
+        int32_t high[3];
+        for (int32_t axis = 0; axis < 3; ++axis) {
+            low[axis] = std::max(center[axis] - ring, 0);
+            high[axis] = std::min(center[axis] + ring, kGridSize - 1);
+        }
+        for (int32_t x = low[0]; x <= high[0]; ++x) {
+            for (int32_t y = low[1]; y <= high[1]; ++y) {
+                int32_t column = (x * kGridSize + y) * kGridSize;
+                if (std::abs(x - center[0]) == ring || std::abs(y - center[1]) == ring) {
+                    for (int32_t z = low[2]; z <= high[2]; ++z) {
+                        ScanCell(column + z, r, g, b, bestDistance, bestHSL);
+                    }
+                    continue;
+                }
+                // Inside the shell on x and y, so only the two z faces are new.
+                if (center[2] - ring >= 0) {
+                    ScanCell(column + center[2] - ring, r, g, b, bestDistance, bestHSL);
+                }
+                if (center[2] + ring < kGridSize) {
+                    ScanCell(column + center[2] + ring, r, g, b, bestDistance, bestHSL);
+                }
+            }
+        }
 
-        uint32_t diff = (dr * dr) + (dg * dg) + (db * db);
-        if (diff < bestDiff) {
-            bestDiff = diff;
-            bestIndex = i;
-            if (diff == 0) {
-                break;
+        // Every color outside the visited cube differs by at least this much
+        // on one of the axes.
+        int32_t gap = INT_MAX;
+        for (int32_t axis = 0; axis < 3; ++axis) {
+            if (center[axis] - ring > 0) {
+                gap = std::min(gap, query[axis] - (center[axis] - ring) * kCellWidth + 1);
+            }
+            if (center[axis] + ring < kGridSize - 1) {
+                gap = std::min(gap, (center[axis] + ring + 1) * kCellWidth - query[axis]);
             }
         }
+        if (gap == INT_MAX || gap * gap > bestDistance) {
+            break;
+        }
     }
-    cache[rgb] = bestIndex;
-    return bestIndex;
+    return bestHSL;
 }
 
-uint32_t RunetekColor::HSLToRGB(uint16_t hsl)
+uint16_t RunetekColor::RGBToHSL(uint32_t rgb)
+{
+    std::call_once(initFlag, [&]() {
+        BuildSearchTables(kHSLToRGB.data());
+    });
+
+    if (rgb <= 0xffffff) {
+        if (uint32_t slot = FindExactSlot(rgb); exactKeys[slot] == rgb) {
+            return exactValues[slot];
+        }
+    }
+    if (uint16_t hsl; FindCached(rgb, hsl)) {
+        cacheHits.fetch_add(1, std::memory_order_relaxed);
+        return hsl;
+    }
+
+    cacheMisses.fetch_add(1, std::memory_order_relaxed);
+    uint16_t nearest = FindNearestHSL(rgb >> 16 & 0xff, rgb >> 8 & 0xff, rgb & 0xff);
+    StoreCached(rgb, nearest);
+    return nearest;
+}
+
+void RunetekColor::RGBToHSL(std::span<uint32_t const> rgb, std::span<uint16_t> hsl)
 {
-    if (!m_hslToRGB) {
-        InitColorTables();
-        assert(m_hslToRGB != nullptr);
+    assert(hsl.size() >= rgb.size());
+    std::vector<uint32_t> distinct(rgb.begin(), rgb.end());
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+    std::vector<uint16_t> distinctHSL(distinct.size());
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        distinctHSL[i] = RGBToHSL(distinct[i]);
+    }
+    for (size_t i = 0; i < rgb.size(); ++i) {
+        hsl[i] = distinctHSL[std::lower_bound(distinct.begin(), distinct.end(), rgb[i]) - distinct.begin()];
     }
-    return m_hslToRGB[hsl];
+}
+
+RunetekColor::CacheStats RunetekColor::GetCacheStats()
+{
+    return { cacheHits.load(std::memory_order_relaxed), cacheMisses.load(std::memory_order_relaxed) };
+}
+
+uint32_t RunetekColor::HSLToRGB(uint16_t hsl)
+{
+    return kHSLToRGB[hsl];
 }
 
 uint32_t RunetekColor::HelperToRGB(uint16_t value)
 {
-    uint8_t r = static_cast<uint8_t>(s_helperColors[value][0] * 255.0f);
-    uint8_t g = static_cast<uint8_t>(s_helperColors[value][1] * 255.0f);
-    uint8_t b = static_cast<uint8_t>(s_helperColors[value][2] * 255.0f);
-    return (r << 16) | (g << 8) | b;
+    return kHelperToRGB[value];
+}
+
+std::span<uint32_t const> RunetekColor::GetHSLPalette()
+{
+    return kHSLToRGB;
+}
+
+std::span<uint32_t const> RunetekColor::GetHelperPalette()
+{
+    return kHelperToRGB;
 }
 }
@@ -1,19 +1,29 @@
 #pragma once
 
 #include <cinttypes>
+#include <span>
 
 namespace imp::math {
 class RunetekColor {
 public:
-    static void InitColorTables();
-    static void DestroyColorTables();
+    struct CacheStats {
+        uint64_t hits;
+        uint64_t misses;
+    };
 
+    // Safe to call from any number of threads.
     static uint16_t RGBToHSL(uint32_t rgb);
+    // Converts a whole list of colors, searching each distinct color once.
+    // hsl must be at least as long as rgb.
+    static void RGBToHSL(std::span<uint32_t const> rgb, std::span<uint16_t> hsl);
+    static CacheStats GetCacheStats();
     static uint32_t HSLToRGB(uint16_t hsl);
 
     static uint32_t HelperToRGB(uint16_t label);
 
-private:
-    static uint32_t* m_hslToRGB;
+    // The lookup tables behind HSLToRGB and HelperToRGB, as 0x00RRGGBB words,
+    // for uploading to the GPU.
+    static std::span<uint32_t const> GetHSLPalette();
+    static std::span<uint32_t const> GetHelperPalette();
 };
 }
@@ -3,7 +3,6 @@
 #include "Dialogs.h"
 
 #include <glad/glad.h>
-#include <glm/mat4x4.hpp>
 
 namespace imp {
 ShaderProgram::ShaderProgram()
@@ -20,91 +19,147 @@ ShaderProgram::~ShaderProgram()
     }
 }
 
-bool ShaderProgram::Create(char const* vertexSource, char const* fragmentSource)
+// Returns 0 after reporting the error if the shader does not compile.
+static GLuint CompileShader(GLenum type, char const* source, char const* errorMessage)
 {
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, nullptr);
-    glCompileShader(vertexShader);
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
 
     int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (success == GL_FALSE) {
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        glDeleteShader(vertexShader);
-        ShowFatalDialog("Error", "Vertex shader compilation failed");
+        glDeleteShader(shader);
+        ShowFatalDialog("Error", errorMessage);
+        return 0;
+    }
+    return shader;
+}
+
+bool ShaderProgram::Create(char const* vertexSource, char const* fragmentSource, char const* geometrySource)
+{
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource, "Vertex shader compilation failed");
+    if (vertexShader == 0) {
         return false;
     }
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
-    glCompileShader(fragmentShader);
+    GLuint geometryShader = 0;
+    if (geometrySource) {
+        geometryShader = CompileShader(GL_GEOMETRY_SHADER, geometrySource, "Geometry shader compilation failed");
+        if (geometryShader == 0) {
+            glDeleteShader(vertexShader);
+            return false;
+        }
+    }
 
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (success == GL_FALSE) {
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource, "Fragment shader compilation failed");
+    if (fragmentShader == 0) {
         glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        ShowFatalDialog("Error", "Fragment shader compilation failed");
+        glDeleteShader(geometryShader);
         return false;
     }
 
     m_id = glCreateProgram();
     glAttachShader(m_id, vertexShader);
+    if (geometryShader != 0) {
+        glAttachShader(m_id, geometryShader);
+    }
     glAttachShader(m_id, fragmentShader);
     glLinkProgram(m_id);
 
+    // Attached shaders are only flagged for deletion until the program goes.
+    glDeleteShader(vertexShader);
+    glDeleteShader(geometryShader);
+    glDeleteShader(fragmentShader);
+
+    int success;
     glGetProgramiv(m_id, GL_LINK_STATUS, &success);
     if (success == GL_FALSE) {
-        glGetProgramInfoLog(m_id, 512, nullptr, infoLog);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
         ShowFatalDialog("Error", "Shader program linking failed");
         return false;
     }
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    ResolveUniforms();
     return true;
 }
 
+void ShaderProgram::ResolveUniforms()
+{
+    m_uniformLocations.clear();
+
+    GLint count = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(static_cast<size_t>(maxNameLength), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_id, static_cast<GLuint>(i), maxNameLength, &length, &size, &type, name.data());
+        std::string uniformName = name.substr(0, static_cast<size_t>(length));
+        // Members of uniform blocks have no location.
+        GLint location = glGetUniformLocation(m_id, uniformName.c_str());
+        if (location < 0) {
+            continue;
+        }
+        // Arrays are reported as "name[0]" but looked up by their plain name.
+        if (uniformName.ends_with("[0]")) {
+            uniformName.resize(uniformName.size() - 3);
+        }
+        m_uniformLocations.emplace(std::move(uniformName), location);
+    }
+}
+
 void ShaderProgram::Bind() const
 {
     glUseProgram(m_id);
 }
 
-void ShaderProgram::SetUniform(char const* name, int value)
+int32_t ShaderProgram::GetUniformLocation(std::string const& name) const
 {
-    glUniform1i(GetUniformLocation(name), value);
+    if (auto const it = m_uniformLocations.find(name); it != m_uniformLocations.end()) {
+        return it->second;
+    }
+    return -1;
 }
 
-void ShaderProgram::SetUniform(char const* name, float value)
+void ShaderProgram::BindUniformBlock(char const* name, uint32_t binding) const
 {
-    glUniform1f(GetUniformLocation(name), value);
+    GLuint index = glGetUniformBlockIndex(m_id, name);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(m_id, index, binding);
+    }
 }
 
-void ShaderProgram::SetUniform(char const* name, glm::vec3 const& value)
+void UploadUniform(int32_t location, int value)
 {
-    glUniform3fv(GetUniformLocation(name), 1, &value[0]);
+    glUniform1i(location, value);
 }
 
-void ShaderProgram::SetUniform(char const* name, glm::vec4 const& value)
+void UploadUniform(int32_t location, float value)
 {
-    glUniform4fv(GetUniformLocation(name), 1, &value[0]);
+    glUniform1f(location, value);
 }
 
-void ShaderProgram::SetUniform(char const* name, glm::mat4 const& value)
+void UploadUniform(int32_t location, glm::vec2 const& value)
 {
-    glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &value[0][0]);
+    glUniform2fv(location, 1, &value[0]);
 }
 
-GLint ShaderProgram::GetUniformLocation(char const* name)
+void UploadUniform(int32_t location, glm::vec3 const& value)
 {
-    if (auto const it = m_uniformLocations.find(name); it != m_uniformLocations.end()) {
-        return it->second;
-    }
-    GLint const location = glGetUniformLocation(m_id, name);
-    m_uniformLocations[name] = location;
-    return location;
+    glUniform3fv(location, 1, &value[0]);
+}
+
+void UploadUniform(int32_t location, glm::vec4 const& value)
+{
+    glUniform4fv(location, 1, &value[0]);
+}
+
+void UploadUniform(int32_t location, glm::mat4 const& value)
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 }
 }
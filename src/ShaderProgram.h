@@ -1,9 +1,49 @@
 #pragma once
 
-#include <glm/fwd.hpp>
+#include <glm/glm.hpp>
+#include <string>
 #include <unordered_map>
 
 namespace imp {
+// Writes to the uniform at location in the currently bound program.
+void UploadUniform(int32_t location, int value);
+void UploadUniform(int32_t location, float value);
+void UploadUniform(int32_t location, glm::vec2 const& value);
+void UploadUniform(int32_t location, glm::vec3 const& value);
+void UploadUniform(int32_t location, glm::vec4 const& value);
+void UploadUniform(int32_t location, glm::mat4 const& value);
+
+// A uniform of one program, looked up once after linking. The last value
+// written is kept, so setting a uniform to what it already holds costs no GL
+// call. Only one handle should exist per uniform, and its program must be
+// bound when Set is called.
+template<typename T>
+class ShaderUniform {
+public:
+    ShaderUniform() = default;
+
+    explicit ShaderUniform(int32_t location)
+        : m_location(location)
+    {
+        // Do nothing.
+    }
+
+    void Set(T const& value)
+    {
+        if (m_location < 0 || (m_hasValue && value == m_value)) {
+            return;
+        }
+        m_value = value;
+        m_hasValue = true;
+        UploadUniform(m_location, value);
+    }
+
+private:
+    int32_t m_location { -1 };
+    T m_value {};
+    bool m_hasValue { false };
+};
+
 class ShaderProgram {
 public:
     ShaderProgram();
@@ -12,15 +52,22 @@ public:
     ShaderProgram(ShaderProgram const&) = delete;
     ShaderProgram& operator=(ShaderProgram const&) = delete;
 
-    bool Create(char const* vertexSource, char const* fragmentSource);
+    // The geometry stage is optional.
+    bool Create(char const* vertexSource, char const* fragmentSource, char const* geometrySource = nullptr);
     void Bind() const;
 
-    void SetUniform(char const* name, int value);
-    void SetUniform(char const* name, float value);
-    void SetUniform(char const* name, glm::vec3 const& value);
-    void SetUniform(char const* name, glm::vec4 const& value);
-    void SetUniform(char const* name, glm::mat4 const& value);
-    int32_t GetUniformLocation(char const* name);
+    // Uniforms the compiler removed resolve to a handle that ignores writes,
+    // same as glUniform does for location -1.
+    template<typename T>
+    ShaderUniform<T> GetUniform(std::string const& name) const
+    {
+        return ShaderUniform<T>(GetUniformLocation(name));
+    }
+
+    int32_t GetUniformLocation(std::string const& name) const;
+    // Points the named uniform block at a uniform buffer binding. Blocks
+    // the program does not use are ignored.
+    void BindUniformBlock(char const* name, uint32_t binding) const;
 
     uint32_t GetId() const
     {
@@ -28,7 +75,10 @@ public:
     }
 
 private:
+    void ResolveUniforms();
+
     uint32_t m_id;
-    std::unordered_map<char const*, int32_t> m_uniformLocations;
+    // Every active uniform outside a block, filled in once at link time.
+    std::unordered_map<std::string, int32_t> m_uniformLocations;
 };
 }
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define IMP_TEXTSCAN_SSE2 1
+#    include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#    define IMP_TEXTSCAN_AVX2 1
+#    include <immintrin.h>
+#endif
+
+// Vectorized character searches used by the text parsers. Each helper
+// returns the first matching position in [it, end), or end if none.
+// The wide loops handle 32 (AVX2) or 16 (SSE2) bytes per step, and the
+// scalar loop only sees the tail or runs on targets without SSE2.
+namespace imp::text {
+inline bool IsSpace(char c)
+{
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+inline char const* FindNewline(char const* it, char const* end)
+{
+#if IMP_TEXTSCAN_AVX2
+    __m256i const newline = _mm256_set1_epi8('\n');
+    for (; end - it >= 32; it += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(it));
+        if (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)))) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+#if IMP_TEXTSCAN_SSE2
+    __m128i const newline16 = _mm_set1_epi8('\n');
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+        if (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline16)))) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; it != end; ++it) {
+        if (*it == '\n') {
+            return it;
+        }
+    }
+    return end;
+}
+
+inline char const* FindBrace(char const* it, char const* end)
+{
+#if IMP_TEXTSCAN_AVX2
+    __m256i const open = _mm256_set1_epi8('{');
+    __m256i const close = _mm256_set1_epi8('}');
+    for (; end - it >= 32; it += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(it));
+        __m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, open), _mm256_cmpeq_epi8(chunk, close));
+        if (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match))) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+#if IMP_TEXTSCAN_SSE2
+    __m128i const open16 = _mm_set1_epi8('{');
+    __m128i const close16 = _mm_set1_epi8('}');
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+        __m128i match = _mm_or_si128(_mm_cmpeq_epi8(chunk, open16), _mm_cmpeq_epi8(chunk, close16));
+        if (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match))) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; it != end; ++it) {
+        if (*it == '{' || *it == '}') {
+            return it;
+        }
+    }
+    return end;
+}
+
+inline char const* SkipSpaces(char const* it, char const* end)
+{
+    // Most runs are a single separator, so check the first byte before
+    // paying for a vector load.
+    if (it == end || !IsSpace(*it)) {
+        return it;
+    }
+#if IMP_TEXTSCAN_AVX2
+    __m256i const space = _mm256_set1_epi8(' ');
+    __m256i const tab = _mm256_set1_epi8('\t');
+    __m256i const controlRange = _mm256_set1_epi8('\r' - '\t');
+    for (; end - it >= 32; it += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(it));
+        // \t..\r are contiguous: (c - '\t') <= 4 as an unsigned byte compare.
+        __m256i offset = _mm256_sub_epi8(chunk, tab);
+        __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, controlRange), offset);
+        __m256i isSpace = _mm256_or_si256(isControl, _mm256_cmpeq_epi8(chunk, space));
+        if (uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(isSpace))) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+#if IMP_TEXTSCAN_SSE2
+    __m128i const space16 = _mm_set1_epi8(' ');
+    __m128i const tab16 = _mm_set1_epi8('\t');
+    __m128i const controlRange16 = _mm_set1_epi8('\r' - '\t');
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+        __m128i offset = _mm_sub_epi8(chunk, tab16);
+        __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(offset, controlRange16), offset);
+        __m128i isSpace = _mm_or_si128(isControl, _mm_cmpeq_epi8(chunk, space16));
+        if (uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(isSpace)) & 0xffffu) {
+            return it + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; it != end; ++it) {
+        if (!IsSpace(*it)) {
+            return it;
+        }
+    }
+    return end;
+}
+}
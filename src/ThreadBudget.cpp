@@ -0,0 +1,31 @@
+#include "ThreadBudget.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace imp {
+// Every thread that asks already runs on one of the cores, so the budget is
+// the rest of them.
+static std::atomic<uint32_t>& AvailableThreads()
+{
+    static std::atomic<uint32_t> available { std::max(1u, std::thread::hardware_concurrency()) - 1 };
+    return available;
+}
+
+ThreadBudget::ThreadBudget(uint32_t wanted)
+{
+    std::atomic<uint32_t>& available = AvailableThreads();
+    uint32_t current = available.load(std::memory_order_relaxed);
+    uint32_t granted;
+    do {
+        granted = std::min(current, wanted);
+    } while (!available.compare_exchange_weak(current, current - granted, std::memory_order_relaxed));
+    m_count = granted;
+}
+
+ThreadBudget::~ThreadBudget()
+{
+    AvailableThreads().fetch_add(m_count, std::memory_order_relaxed);
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <cstdint>
+
+namespace imp {
+// Process-wide limit on extra worker threads, so that parallel work nested
+// inside other parallel work (each model of a batch export parsing its
+// sections in parallel) does not start threads squared. A reservation
+// borrows up to the requested number of threads for as long as it lives and
+// may be granted fewer, or none, in which case the caller does the work on
+// its own thread.
+class ThreadBudget {
+public:
+    explicit ThreadBudget(uint32_t wanted);
+    ~ThreadBudget();
+
+    MAKE_NON_COPYABLE(ThreadBudget);
+
+    uint32_t GetCount() const
+    {
+        return m_count;
+    }
+
+private:
+    uint32_t m_count { 0 };
+};
+}
@@ -1,7 +1,7 @@
 #pragma once
 
 namespace imp {
-static double s_helperColors[800][3] {
+constexpr double s_helperColors[800][3] {
     { 1.000, 1.000, 1.000 },
     { 1.000, 0.000, 0.000 },
     { 1.000, 0.502, 0.000 },
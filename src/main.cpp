@@ -1,32 +1,39 @@
+#include "BatchExporter.h"
 #include "ModelViewer.h"
-#include "RunetekColor.h"
 
-void RunApp()
+int RunApp(int argc, char** argv)
 {
     using namespace imp;
-    math::RunetekColor::InitColorTables();
-    ModelViewer app;
-    app.Start();
-    math::RunetekColor::DestroyColorTables();
+    int exitCode = 0;
+    if (BatchExporter::IsBatchCommand(argc, argv)) {
+        exitCode = BatchExporter::Run(argc, argv);
+    } else {
+        ModelViewer app;
+        app.Start();
+    }
+    return exitCode;
 }
 
 #ifdef IMP_PLATFORM_WINDOWS
 #    include <Windows.h>
+#    include <cstdio>
 int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
     (void)hInstance;
     (void)hPrevInstance;
     (void)lpCmdLine;
     (void)nCmdShow;
-    RunApp();
-    return 0;
+    // This is a GUI subsystem executable, so batch mode has to borrow the
+    // console of whatever launched it to be able to report progress.
+    if (imp::BatchExporter::IsBatchCommand(__argc, __argv) && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+    return RunApp(__argc, __argv);
 }
 #else
 int main(int argc, char** argv)
 {
-    (void)argc;
-    (void)argv;
-    RunApp();
-    return 0;
+    return RunApp(argc, argv);
 }
 #endif
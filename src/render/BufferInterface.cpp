@@ -1,6 +1,9 @@
 #include "BufferInterface.h"
 
 #include "GLUtils.h"
+#include "UploadRing.h"
+
+#include <algorithm>
 
 namespace imp {
 bool BufferInterface::CreateInternal(uint32_t target, uint32_t staticUsage, uint32_t dynamicUsage, uint32_t size, BufferCreateFlags flags, void const* data)
@@ -33,11 +36,51 @@ void BufferInterface::UpdateInternal(int32_t target, uint32_t usage, uint32_t of
 {
     IMP_DEBUG_ASSERT(m_id != 0);
     IMP_DEBUG_ASSERT(data != nullptr);
-    IMP_DEBUG_ASSERT(offset + size <= m_size);
+
+    if (offset + size > m_size) {
+        ReserveInternal(usage, offset + size, offset);
+    }
+    if (m_uploadRing && m_uploadRing->Upload(m_id, offset, size, data)) {
+        return;
+    }
 
     GLCALL(glBindBuffer(target, m_id));
     GLCALL(glBufferSubData(target, offset, size, data));
     GLCALL(glBindBuffer(target, 0));
 }
 
+void BufferInterface::ReserveInternal(uint32_t usage, uint32_t size, uint32_t preserveSize)
+{
+    IMP_DEBUG_ASSERT(m_id != 0);
+    if (size <= m_size) {
+        return;
+    }
+
+    uint64_t grownSize = std::max<uint64_t>(size, static_cast<uint64_t>(m_size) * 2);
+    uint32_t newSize = static_cast<uint32_t>(std::min<uint64_t>(grownSize, UINT32_MAX));
+    preserveSize = std::min(preserveSize, m_size);
+
+    // Respecifying the store discards it, so anything worth keeping takes a
+    // round trip through a scratch buffer. Both copies stay on the GPU.
+    uint32_t scratch = 0;
+    if (preserveSize > 0) {
+        GLCALL(glGenBuffers(1, &scratch));
+        GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, m_id));
+        GLCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, scratch));
+        GLCALL(glBufferData(GL_COPY_WRITE_BUFFER, preserveSize, nullptr, GL_STREAM_COPY));
+        GLCALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, preserveSize));
+    }
+
+    GLCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, m_id));
+    GLCALL(glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, usage));
+
+    if (scratch != 0) {
+        GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, scratch));
+        GLCALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, preserveSize));
+        GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        glDeleteBuffers(1, &scratch);
+    }
+    GLCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    m_size = newSize;
+}
 }
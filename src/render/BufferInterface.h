@@ -4,6 +4,8 @@
 #include <cinttypes>
 
 namespace imp {
+class UploadRing;
+
 enum BufferCreateFlags : uint8_t {
     BUFFER_FLAG_NONE = 0x0,
     BUFFER_FLAG_DYNAMIC = BIT(0),
@@ -20,14 +22,33 @@ public:
         return m_id;
     }
 
+    uint32_t GetSize() const
+    {
+        return m_size;
+    }
+
+    // Routes updates through a persistently mapped staging ring. The ring
+    // must outlive the buffer or be detached first.
+    void SetUploadRing(UploadRing* ring)
+    {
+        m_uploadRing = ring;
+    }
+
 protected:
     bool CreateInternal(uint32_t target, uint32_t staticUsage, uint32_t dynamicUsage, uint32_t size, BufferCreateFlags flags, void const* data);
     void DestroyInternal();
 
+    // Updates past the end grow the buffer first, see ReserveInternal.
     void UpdateInternal(int32_t target, uint32_t usage, uint32_t offset, uint32_t size, void const* data);
+    // Grows the storage to at least size bytes, at least doubling it so a
+    // growing model reallocates a logarithmic number of times. The buffer
+    // keeps its name, so VAOs and buffer textures referring to it stay valid,
+    // and the first preserveSize bytes are kept.
+    void ReserveInternal(uint32_t usage, uint32_t size, uint32_t preserveSize);
 
     uint32_t m_id { 0 };
     uint32_t m_size { 0 };
     uint8_t m_flags { 0x0 };
+    UploadRing* m_uploadRing { nullptr };
 };
 }
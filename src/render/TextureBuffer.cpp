@@ -0,0 +1,37 @@
+#include "TextureBuffer.h"
+
+#include "GLUtils.h"
+
+namespace imp {
+bool TextureBuffer::Create(uint32_t size, uint32_t internalFormat, BufferCreateFlags flags, void const* data)
+{
+    if (!CreateInternal(GL_TEXTURE_BUFFER, GL_STATIC_DRAW, GL_DYNAMIC_DRAW, size, flags, data)) {
+        return false;
+    }
+    GLCALL(glGenTextures(1, &m_texture));
+    GLCALL(glBindTexture(GL_TEXTURE_BUFFER, m_texture));
+    GLCALL(glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, m_id));
+    GLCALL(glBindTexture(GL_TEXTURE_BUFFER, 0));
+    return true;
+}
+
+void TextureBuffer::Destroy()
+{
+    if (m_texture != 0) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+    DestroyInternal();
+}
+
+void TextureBuffer::Update(uint32_t offset, uint32_t size, void const* data)
+{
+    UpdateInternal(GL_TEXTURE_BUFFER, GL_DYNAMIC_DRAW, offset, size, data);
+}
+
+void TextureBuffer::Bind(uint32_t unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+}
+}
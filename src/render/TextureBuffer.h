@@ -0,0 +1,29 @@
+#pragma once
+
+#include "BufferInterface.h"
+
+namespace imp {
+// Buffer object exposed to shaders through a buffer texture, for per-element
+// data that is looked up with texelFetch rather than streamed as attributes.
+class TextureBuffer final : public BufferInterface {
+    MAKE_NON_COPYABLE(TextureBuffer);
+
+public:
+    TextureBuffer() = default;
+    ~TextureBuffer() override = default;
+
+    bool Create(uint32_t size, uint32_t internalFormat, BufferCreateFlags flags, void const* data);
+    void Destroy();
+
+    void Update(uint32_t offset, uint32_t size, void const* data);
+    void Bind(uint32_t unit) const;
+
+    uint32_t GetNativeTexture() const
+    {
+        return m_texture;
+    }
+
+private:
+    uint32_t m_texture { 0 };
+};
+}
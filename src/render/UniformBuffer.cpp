@@ -0,0 +1,26 @@
+#include "UniformBuffer.h"
+
+#include "GLUtils.h"
+
+namespace imp {
+bool UniformBuffer::Create(uint32_t size, BufferCreateFlags flags, void const* data)
+{
+    return CreateInternal(GL_UNIFORM_BUFFER, GL_STATIC_DRAW, GL_DYNAMIC_DRAW, size, flags, data);
+}
+
+void UniformBuffer::Destroy()
+{
+    DestroyInternal();
+}
+
+void UniformBuffer::Update(uint32_t offset, uint32_t size, void const* data)
+{
+    UpdateInternal(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW, offset, size, data);
+}
+
+void UniformBuffer::BindBase(uint32_t binding) const
+{
+    IMP_DEBUG_ASSERT(m_id != 0);
+    GLCALL(glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_id));
+}
+}
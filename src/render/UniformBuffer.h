@@ -0,0 +1,20 @@
+#pragma once
+
+#include "BufferInterface.h"
+
+namespace imp {
+class UniformBuffer final : public BufferInterface {
+    MAKE_NON_COPYABLE(UniformBuffer);
+
+public:
+    UniformBuffer() = default;
+    ~UniformBuffer() override = default;
+
+    bool Create(uint32_t size, BufferCreateFlags flags, void const* data);
+    void Destroy();
+
+    void Update(uint32_t offset, uint32_t size, void const* data);
+    // Makes this buffer the source of every uniform block bound to binding.
+    void BindBase(uint32_t binding) const;
+};
+}
@@ -0,0 +1,119 @@
+#include "UploadRing.h"
+
+#include "GLUtils.h"
+
+#include <cstring>
+
+namespace imp {
+// Keeps the copies' source offsets friendly for the DMA engines.
+constexpr uint32_t kUploadAlignment = 256;
+
+bool UploadRing::IsSupported()
+{
+    return GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+}
+
+bool UploadRing::Create(uint32_t size)
+{
+    IMP_DEBUG_ASSERT(m_id == 0);
+    if (!IsSupported()) {
+        return false;
+    }
+
+    constexpr GLbitfield kFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLCALL(glGenBuffers(1, &m_id));
+    GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, m_id));
+    GLCALL(glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, kFlags));
+    m_mapping = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, kFlags));
+    GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    if (m_mapping == nullptr) {
+        IMP_LOG_WARN("Unable to map upload buffer, falling back to glBufferSubData.");
+        Destroy();
+        return false;
+    }
+    m_size = size;
+    m_head = 0;
+    return true;
+}
+
+void UploadRing::Destroy()
+{
+    for (Region const& region : m_inFlight) {
+        glDeleteSync(region.fence);
+    }
+    m_inFlight.clear();
+    if (m_id == 0) {
+        return;
+    }
+    if (m_mapping != nullptr) {
+        glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        m_mapping = nullptr;
+    }
+    glDeleteBuffers(1, &m_id);
+    m_id = 0;
+    m_size = 0;
+}
+
+bool UploadRing::Upload(uint32_t buffer, uint32_t offset, uint32_t size, void const* data)
+{
+    if (m_mapping == nullptr || size > m_size) {
+        return false;
+    }
+    RetireFinished();
+
+    uint32_t begin = (m_head + kUploadAlignment - 1) & ~(kUploadAlignment - 1);
+    if (begin > m_size || m_size - begin < size) {
+        begin = 0;
+    }
+    WaitForSpace(begin, begin + size);
+
+    std::memcpy(m_mapping + begin, data, size);
+    GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, m_id));
+    GLCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    GLCALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, begin, offset, size));
+    GLCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    GLCALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+    m_inFlight.push_back({ begin, begin + size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    m_head = begin + size;
+    return true;
+}
+
+void UploadRing::RetireFinished()
+{
+    while (!m_inFlight.empty()) {
+        GLenum status = glClientWaitSync(m_inFlight.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            return;
+        }
+        glDeleteSync(m_inFlight.front().fence);
+        m_inFlight.pop_front();
+    }
+}
+
+void UploadRing::WaitForSpace(uint32_t begin, uint32_t end)
+{
+    // The GPU finishes the copies in order, so waiting on the newest region
+    // that overlaps also retires every region before it.
+    auto last = m_inFlight.end();
+    for (auto it = m_inFlight.begin(); it != m_inFlight.end(); ++it) {
+        if (it->begin < end && begin < it->end) {
+            last = it;
+        }
+    }
+    if (last == m_inFlight.end()) {
+        return;
+    }
+
+    constexpr GLuint64 kWaitTimeout = 1'000'000'000;
+    while (glClientWaitSync(last->fence, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitTimeout) == GL_TIMEOUT_EXPIRED) {
+        // Keep waiting, the copy has been submitted and will complete.
+    }
+    for (auto it = m_inFlight.begin(); it != std::next(last); ++it) {
+        glDeleteSync(it->fence);
+    }
+    m_inFlight.erase(m_inFlight.begin(), std::next(last));
+}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../Utils.h"
+#include <cinttypes>
+#include <deque>
+
+typedef struct __GLsync* GLsync;
+
+namespace imp {
+// Persistently mapped staging buffer for uploads to other buffers. Data is
+// memcpy'd into the mapping and copied on the GPU with glCopyBufferSubData,
+// so the driver never has to stall on or shadow a glBufferSubData. Each
+// upload is fenced and its space is only reused once the GPU is done with it.
+// Requires ARB_buffer_storage (core in 4.4), see IsSupported.
+class UploadRing {
+    MAKE_NON_COPYABLE(UploadRing);
+
+public:
+    UploadRing() = default;
+    ~UploadRing() = default;
+
+    static bool IsSupported();
+
+    bool Create(uint32_t size);
+    void Destroy();
+
+    bool IsCreated() const
+    {
+        return m_mapping != nullptr;
+    }
+
+    // Returns false without doing anything if the ring cannot hold the data,
+    // in which case the caller uploads it some other way.
+    bool Upload(uint32_t buffer, uint32_t offset, uint32_t size, void const* data);
+
+private:
+    struct Region {
+        uint32_t begin;
+        uint32_t end;
+        GLsync fence;
+    };
+
+    void RetireFinished();
+    void WaitForSpace(uint32_t begin, uint32_t end);
+
+    uint32_t m_id { 0 };
+    uint32_t m_size { 0 };
+    uint32_t m_head { 0 };
+    uint8_t* m_mapping { nullptr };
+    std::deque<Region> m_inFlight;
+};
+}
@@ -3,8 +3,10 @@ static auto gridVertexShaderSource = R"(
 
 layout (location = 0) in vec3 aVertexPosition;
 
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
+layout (std140) uniform Camera {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+};
 
 out vec3 vWorldPosition;
 
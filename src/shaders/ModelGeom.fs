@@ -1,32 +1,132 @@
 static auto modelGeomFragmentShader = R"(
 #version 330 core
 
-in vec4 vVertexColor;
-in float vHighlight;
-in float vVertexIndex;
+flat in vec2 gCorner0;
+flat in vec2 gCorner1;
+flat in vec2 gCorner2;
+flat in vec3 gCornerHighlight;
+flat in int gHasCorners;
 
 uniform vec4 uHighlightColor;
 uniform vec4 uSelectedColor;
-uniform int uHighlightVertex;
-uniform int uSelectedVertex;
+uniform int uHighlightFace;
+uniform int uSelectedFace;
+uniform int uVertexMode;
+uniform int uColorMode;
+
+// Two RGBA16UI texels per face:
+//   [0] r = HSL color, g = label, b = priority, a = trans
+//   [1] r = material, g = mapping, b = type
+// 0xFFFF marks an attribute the face does not have.
+uniform usamplerBuffer uFaceData;
+uniform sampler2D uHSLPalette;
+uniform sampler2D uHelperPalette;
+// The face behind each drawn primitive. Faces are drawn sorted, and a draw
+// that starts partway into the index buffer passes its first primitive.
+uniform usamplerBuffer uFaceOrder;
+uniform int uFirstPrimitive;
+
+// The wireframe and the vertex dots are drawn over the faces in the same
+// pass, sized in pixels.
+uniform int uWireframe;
+uniform vec4 uWireframeColor;
+uniform float uWireframeWidth;
+uniform float uVertexSize;
 
 out vec4 FragColor;
 
-uniform bool uOverrideColorEnabled;
-uniform vec4 uOverrideColor;
+const uint kMissing = 0xFFFFu;
+
+vec4 HelperColor(uint value, vec4 missingColor)
+{
+    if (value == kMissing) {
+        return missingColor;
+    }
+    int index = int(value) % textureSize(uHelperPalette, 0).x;
+    return vec4(texelFetch(uHelperPalette, ivec2(index, 0), 0).rgb, 1.0);
+}
+
+vec4 FaceColor(int faceID)
+{
+    uvec4 face = texelFetch(uFaceData, faceID * 2);
+    // 0 = diffuse, 1 = priority, 2 = label, 3 = trans, 4 = material, 5 = mapping
+    if (uColorMode == 1) {
+        return HelperColor(face.b, vec4(0.7, 0.7, 0.7, 1.0));
+    }
+    if (uColorMode == 2) {
+        return HelperColor(face.g, vec4(0.5, 0.5, 0.5, 1.0));
+    }
+    if (uColorMode == 3) {
+        return HelperColor(face.a, vec4(0.7, 0.7, 0.7, 1.0));
+    }
+    if (uColorMode >= 4) {
+        uvec4 extra = texelFetch(uFaceData, faceID * 2 + 1);
+        return HelperColor(uColorMode == 4 ? extra.r : extra.g, vec4(0.5, 0.5, 0.5, 1.0));
+    }
+    ivec2 hsl = ivec2(int(face.r & 0xFFu), int(face.r >> 8));
+    float alpha = face.a == kMissing ? 1.0 : 1.0 - float(face.a) / 255.0;
+    return vec4(texelFetch(uHSLPalette, hsl, 0).rgb, alpha);
+}
+
+// Distance in pixels from p to the line through a and b.
+float EdgeDistance(vec2 p, vec2 a, vec2 b)
+{
+    vec2 edge = b - a;
+    float edgeLength = length(edge);
+    if (edgeLength < 1e-6) {
+        return distance(p, a);
+    }
+    return abs(edge.x * (p.y - a.y) - edge.y * (p.x - a.x)) / edgeLength;
+}
+
+// How much of a pixel offset pixels away from the center of a line or dot
+// of the given radius it covers, with a pixel wide falloff for antialiasing.
+float Coverage(float offset, float radius)
+{
+    return 1.0 - smoothstep(radius - 0.5, radius + 0.5, offset);
+}
+
+vec4 Over(vec4 base, vec4 color, float coverage)
+{
+    float alpha = color.a * coverage;
+    return vec4(mix(base.rgb, color.rgb, alpha), mix(base.a, 1.0, alpha));
+}
 
 void main()
 {
-    if (vHighlight > 1.5) {
-        FragColor = mix(vVertexColor, uSelectedColor, 0.5);
-    } else if (vHighlight > 0.5) {
-        FragColor = mix(vVertexColor, uHighlightColor, 0.5);
-    } else {
-        if (uOverrideColorEnabled) {
-            FragColor = uOverrideColor;
-        } else {
-            FragColor = vVertexColor;
+    int faceID = int(texelFetch(uFaceOrder, gl_PrimitiveID + uFirstPrimitive).r);
+    vec4 color = FaceColor(faceID);
+
+    if (uVertexMode == 0) {
+        if (faceID == uSelectedFace) {
+            color = mix(color, uSelectedColor, 0.5);
+        } else if (faceID == uHighlightFace) {
+            color = mix(color, uHighlightColor, 0.5);
         }
     }
+
+    // Each face draws its half of a shared edge and its sector of a shared
+    // vertex, so together they make up the full line width and dot.
+    if (gHasCorners == 1) {
+        vec2 p = gl_FragCoord.xy;
+        if (uWireframe == 1) {
+            float edge = min(min(EdgeDistance(p, gCorner0, gCorner1), EdgeDistance(p, gCorner1, gCorner2)), EdgeDistance(p, gCorner2, gCorner0));
+            color = Over(color, uWireframeColor, Coverage(edge, uWireframeWidth * 0.5));
+        }
+        if (uVertexMode == 1) {
+            vec3 distances = vec3(distance(p, gCorner0), distance(p, gCorner1), distance(p, gCorner2));
+            int corner = distances.x < distances.y ? (distances.x < distances.z ? 0 : 2) : (distances.y < distances.z ? 1 : 2);
+            float highlight = gCornerHighlight[corner];
+            vec4 dotColor = uWireframeColor;
+            if (highlight > 1.5) {
+                dotColor = mix(dotColor, uSelectedColor, 0.5);
+            } else if (highlight > 0.5) {
+                dotColor = mix(dotColor, uHighlightColor, 0.5);
+            }
+            color = Over(color, dotColor, Coverage(distances[corner], uVertexSize * 0.5));
+        }
+    }
+
+    FragColor = color;
 }
 )";
\ No newline at end of file
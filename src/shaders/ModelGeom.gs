@@ -0,0 +1,45 @@
+static auto modelGeomGeometryShader = R"(
+#version 330 core
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+uniform vec2 uViewportSize;
+
+in float vVertexHighlight[];
+
+// The face's corners in window coordinates, for the fragment shader to
+// measure its distance to the edges and vertices in pixels.
+flat out vec2 gCorner0;
+flat out vec2 gCorner1;
+flat out vec2 gCorner2;
+flat out vec3 gCornerHighlight;
+flat out int gHasCorners;
+
+vec2 WindowPosition(vec4 position)
+{
+    return (position.xy / position.w * 0.5 + 0.5) * uViewportSize;
+}
+
+void main()
+{
+    // A corner behind the camera has no window position. Such faces are
+    // only ever partly on screen, so they go without the overlay.
+    bool hasCorners = gl_in[0].gl_Position.w > 0.0 && gl_in[1].gl_Position.w > 0.0 && gl_in[2].gl_Position.w > 0.0;
+    vec2 corner0 = hasCorners ? WindowPosition(gl_in[0].gl_Position) : vec2(0.0);
+    vec2 corner1 = hasCorners ? WindowPosition(gl_in[1].gl_Position) : vec2(0.0);
+    vec2 corner2 = hasCorners ? WindowPosition(gl_in[2].gl_Position) : vec2(0.0);
+
+    for (int i = 0; i < 3; ++i) {
+        gl_Position = gl_in[i].gl_Position;
+        gl_PrimitiveID = gl_PrimitiveIDIn;
+        gCorner0 = corner0;
+        gCorner1 = corner1;
+        gCorner2 = corner2;
+        gCornerHighlight = vec3(vVertexHighlight[0], vVertexHighlight[1], vVertexHighlight[2]);
+        gHasCorners = hasCorners ? 1 : 0;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+)";
\ No newline at end of file
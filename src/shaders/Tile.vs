@@ -6,13 +6,22 @@ layout (location = 1) in vec2 aVertexUV;
 
 out vec2 vTextureUV;
 
-uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
+layout (std140) uniform Camera {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+};
+
+uniform int uTileGridSize;
+uniform float uTileSize;
 
 void main()
 {
-    gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * vec4(aVertexPosition, 1.0);
+    // One instance per tile, laid out row by row and centered on the origin.
+    int row = gl_InstanceID / uTileGridSize;
+    int col = gl_InstanceID % uTileGridSize;
+    vec2 offset = (vec2(col, row) + 0.5 - float(uTileGridSize) * 0.5) * uTileSize;
+
+    gl_Position = uProjectionMatrix * uViewMatrix * vec4(aVertexPosition + vec3(offset.x, 0.0, offset.y), 1.0);
     vTextureUV = aVertexUV;
 }
 )";
\ No newline at end of file